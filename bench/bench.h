@@ -0,0 +1,88 @@
+#if !defined(LSST_RASMUSSEN_BENCH_H)
+#define LSST_RASMUSSEN_BENCH_H
+/*
+ * Utilities shared by the benchmarks:  synthetic events, a clock, and reporting in a form that
+ * people (the default) or scripts (-j: one JSON object per line) can read
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <sys/time.h>
+#include "lsst/rasmussen/Event.h"
+
+namespace bench {
+/*
+ * A cheap, reproducible, set of events; a bright centre with a few split pixels
+ */
+inline std::vector<lsst::rasmussen::Event>
+makeEvents(int const nevent)
+{
+    std::srand(12345);
+
+    std::vector<lsst::rasmussen::Event> events;
+    events.reserve(nevent);
+
+    data_str ds;
+    ds.framenum = ds.chipnum = 0;
+    ds.mode = 0;
+    for (int i = 0; i != nevent; ++i) {
+        for (int j = 0; j != 9; ++j) {
+            ds.data[j] = std::rand()%40 - 10;
+        }
+        ds.data[4] = 300 + std::rand()%1700;
+        ds.x = std::rand()%2000;
+        ds.y = std::rand()%2000;
+
+        events.push_back(lsst::rasmussen::Event(ds));
+    }
+
+    return events;
+}
+
+inline double
+now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+/*
+ * Report how long it took to process nevent events (or pixels; whatever the benchmark's unit is)
+ * occupying nbyte bytes
+ */
+class Reporter {
+public:
+    /*
+     * Look for -j in argv, removing it if present so the caller can parse what's left
+     */
+    Reporter(int *argc, char **argv) : _json(false) {
+        int j = 1;
+        for (int i = 1; i != *argc; ++i) {
+            if (strcmp(argv[i], "-j") == 0) {
+                _json = true;
+            } else {
+                argv[j++] = argv[i];
+            }
+        }
+        *argc = j;
+    }
+
+    void operator()(char const *name, double elapsed, double nevent, double nbyte,
+                    char const *unit="event") const {
+        if (_json) {
+            printf("{\"name\": \"%s\", \"unit\": \"%s\", \"n\": %.0f, \"seconds\": %.6g, "
+                   "\"ns_per_%s\": %.6g, \"%ss_per_s\": %.6g, \"bytes_per_s\": %.6g}\n",
+                   name, unit, nevent, elapsed, unit, 1e9*elapsed/nevent, unit, nevent/elapsed,
+                   nbyte/elapsed);
+        } else {
+            printf("%-32s %8.2f ns/%-5s %10.4g %ss/s %10.4g bytes/s\n",
+                   name, 1e9*elapsed/nevent, unit, nevent/elapsed, unit, nbyte/elapsed);
+        }
+        fflush(stdout);
+    }
+private:
+    bool _json;
+};
+}
+#endif
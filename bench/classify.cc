@@ -0,0 +1,130 @@
+/*
+ * Time HistogramTable::classify for each of its pixel types, to check that the saturation-safe
+ * (int and float) variants are no slower than the historical short one, and that none of them
+ * is slower than classification was before it flagged saturated and overflowing pixels
+ * ("classify.unflagged")
+ *
+ * Usage: classify [-j] [nevent [niter]]
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+#include "lsst/rasmussen/tables.h"
+#include "lsst/rasmussen/grades.h"
+#include "bench.h"
+
+namespace {
+/*
+ * HistogramTable::classify as it was before pixels were flagged:  always short pixels, converted
+ * without checking their range, and no cached classifications.  Only used as a baseline, with
+ * TNONE (so there's no reset clock correction to apply)
+ */
+class UnflaggedTable : public HistogramTable {
+public:
+    UnflaggedTable(int event, int split, int filter, calctype do_what) :
+        HistogramTable(event, split, TNONE, 0.0, filter, do_what) {}
+
+    virtual int classify(lsst::rasmussen::Event *ev) const {
+        short phe[9];
+        std::copy(ev->data, ev->data + 9, phe);
+
+        unsigned char map = 0;
+        ev->p9 = 0;
+        ev->sum = 0;
+        for (int j = 0; j < 9; j++) {
+            const short phj = phe[j];
+
+            switch (_do_what) {
+              case P_9:
+                ev->p9 += phj;
+                break;
+              case P_1357:
+                if (j == 1 || j == 3 || j == 5 || j == 7 || j == 4) ev->p9 += phj;
+                break;
+              case P_17:
+                if (j == 1 || j == 7 || j == 4) ev->p9 += phj;
+                break;
+              case P_35:
+                if (j == 3 || j == 5 || j == 4) ev->p9 += phj;
+                break;
+              case P_LIST:
+                break;
+            }
+
+            if (phj < _split && j != 4) {
+                phe[j] = 0;
+                continue;
+            }
+            switch (j) {
+              case 0: map |= 0x01;               ; break;
+              case 1: map |= 0x02; ev->sum += phj; break;
+              case 2: map |= 0x04;               ; break;
+              case 3: map |= 0x08; ev->sum += phj; break;
+              case 4:              ev->sum += phj; break;
+              case 5: map |= 0x10; ev->sum += phj; break;
+              case 6: map |= 0x20;               ; break;
+              case 7: map |= 0x40; ev->sum += phj; break;
+              case 8: map |= 0x80;               ; break;
+            }
+        }
+        ev->grade = static_cast<lsst::rasmussen::Event::Grade>(rv_grades[map].grade);
+
+        const unsigned char xtr = rv_grades[map].extra;
+        if (xtr) {
+            for (int j = 0; j < 4; j++) {
+                if (xtr & rv_corner_bit[j]) ev->sum += phe[rv_corner_pixel[j]];
+            }
+        }
+        ev->map = map;
+
+        return map;
+    }
+};
+}
+
+int
+main(int argc, char **argv)
+{
+    bench::Reporter const report(&argc, argv);
+    int const nevent = (argc > 1) ? atoi(argv[1]) : 1000000;
+    int const niter = (argc > 2) ? atoi(argv[2]) : 10;
+
+    std::vector<lsst::rasmussen::Event> events = bench::makeEvents(nevent);
+
+    struct {
+        HistogramTable::pixeltype type;
+        char const *name;
+    } const types[] = {
+        { HistogramTable::SHORT, "unflagged" }, // the baseline; see UnflaggedTable
+        { HistogramTable::SHORT, "short" },
+        { HistogramTable::INT,   "int" },
+        { HistogramTable::FLOAT, "float" },
+    };
+
+    for (unsigned int i = 0; i != sizeof(types)/sizeof(types[0]); ++i) {
+        UnflaggedTable unflagged(30, 10, ~0, HistogramTable::P_9);
+        HistogramTable plain(30, 10, HistogramTable::TNONE, 0.0, ~0, HistogramTable::P_9);
+        HistogramTable & table = (i == 0) ? unflagged : plain;
+        table.setPixelType(types[i].type);
+
+        int nflagged = 0;
+        double const t0 = bench::now();
+        for (int it = 0; it != niter; ++it) {
+            for (int j = 0; j != nevent; ++j) {
+                events[j].invalidateClassification(); // or classify() just returns the cached answer
+                table.classify(&events[j]);
+                nflagged += (events[j].flags != 0);
+            }
+        }
+        double const elapsed = bench::now() - t0;
+
+        char name[32];
+        sprintf(name, "classify.%s", types[i].name);
+        report(name, elapsed, static_cast<double>(niter)*nevent,
+               static_cast<double>(niter)*nevent*sizeof(events[0].data));
+        fprintf(stderr, "%s: %d flagged\n", name, nflagged);
+    }
+
+    return 0;
+}
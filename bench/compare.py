@@ -0,0 +1,49 @@
+#!/usr/bin/env python
+"""
+Compare two runs of the benchmarks, as written with -j (one JSON object per line), e.g.
+    hotpaths -j > new.json
+    compare.py old.json new.json
+
+Exits with status 1 if any benchmark is slower than before by more than the tolerance
+"""
+import json
+import sys
+import argparse
+
+def read(fileName):
+    results = {}
+    with open(fileName) as fd:
+        for line in fd:
+            line = line.strip()
+            if line.startswith("{"):
+                r = json.loads(line)
+                results[r["name"]] = r
+    return results
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("old", help="Reference results")
+    parser.add_argument("new", help="Results to check")
+    parser.add_argument("--tolerance", type=float, default=0.1,
+                        help="Fractional slowdown to tolerate (default: %(default)s)")
+    args = parser.parse_args()
+
+    old, new = read(args.old), read(args.new)
+
+    nslow = 0
+    print "%-32s %12s %12s %8s" % ("benchmark", "old ns/unit", "new ns/unit", "ratio")
+    for name in sorted(set(old) & set(new)):
+        o = old[name]["seconds"]/old[name]["n"]
+        n = new[name]["seconds"]/new[name]["n"]
+        ratio = n/o
+        slow = ratio > 1 + args.tolerance
+        nslow += slow
+        print "%-32s %12.2f %12.2f %8.3f%s" % (name, 1e9*o, 1e9*n, ratio, "  SLOWER" if slow else "")
+
+    for name in sorted(set(old) ^ set(new)):
+        print "%-32s only in %s" % (name, args.old if name in old else args.new)
+
+    return 1 if nslow else 0
+
+if __name__ == "__main__":
+    sys.exit(main())
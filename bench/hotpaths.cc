@@ -0,0 +1,223 @@
+/*
+ * Time the hot paths of event extraction and classification on synthetic data:
+ *   HistogramTable::classify (from scratch, and returning a cached classification)
+ *   HistogramTable::process_event
+ *   Event(Image, Point2I) for float and uint16 images
+ *   readEventFile
+ *   medpictSearch (medpict_lsst -b -e) with a median bias, and with a bias file;  the difference is
+ *   the cost of the median
+ *
+ * Usage: hotpaths [-j] [nevent [niter [nframe]]]
+ *
+ * With -j each result is written as a line of JSON, for comparison between releases
+ * (e.g. with compare.py)
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "boost/cstdint.hpp"
+#include "fitsio.h"
+#include "lsst/afw/image/Image.h"
+#include "lsst/afw/geom/Point.h"
+#include "lsst/rasmussen/tables.h"
+#include "lsst/rasmussen/search.h"
+#include "bench.h"
+
+namespace afwImage = lsst::afw::image;
+namespace afwGeom = lsst::afw::geom;
+namespace ras = lsst::rasmussen;
+
+namespace {
+std::string
+tempName(char const *what)
+{
+    char const *dir = getenv("TMPDIR");
+    char name[1024];
+    sprintf(name, "%s/bench-%s-%d", (dir ? dir : "/tmp"), what, static_cast<int>(getpid()));
+    return name;
+}
+
+void
+checkFits(int status)
+{
+    if (status != 0) {
+        fits_report_error(stderr, status);
+        exit(1);
+    }
+}
+/*
+ * Write an nx*ny frame with a bias level of bias (plus a little noise), and nevent single-pixel
+ * events of between 300 and 2000 DN
+ */
+void
+writeFrame(std::string const& fileName, int nx, int ny, int bias, int nevent)
+{
+    std::vector<int> pixels(static_cast<size_t>(nx)*ny);
+    for (size_t i = 0; i != pixels.size(); ++i) {
+        pixels[i] = bias + std::rand()%7 - 3;
+    }
+    for (int i = 0; i != nevent; ++i) {
+        pixels[1 + std::rand()%(nx - 2) + (1 + std::rand()%(ny - 2))*static_cast<size_t>(nx)] +=
+            300 + std::rand()%1700;
+    }
+
+    int status = 0;
+    fitsfile *fptr = NULL;
+    long naxes[2] = { nx, ny };
+    long fpixel[2] = { 1L, 1L };
+    fits_create_file(&fptr, ("!" + fileName).c_str(), &status);
+    fits_create_img(fptr, LONG_IMG, 2, naxes, &status);
+    fits_write_pix(fptr, TINT, fpixel, pixels.size(), &pixels[0], &status);
+    fits_close_file(fptr, &status);
+    checkFits(status);
+}
+
+template<typename PixelT>
+void
+timeEventCtor(bench::Reporter const& report, char const *name, int nevent, int niter)
+{
+    afwImage::Image<PixelT> im(afwGeom::Extent2I(2048, 2048));
+    for (int y = 0; y != im.getHeight(); ++y) {
+        for (typename afwImage::Image<PixelT>::x_iterator ptr = im.row_begin(y), end = im.row_end(y);
+             ptr != end; ++ptr) {
+            *ptr = 1000 + std::rand()%100;
+        }
+    }
+    std::vector<afwGeom::Point2I> centers;
+    centers.reserve(nevent);
+    for (int i = 0; i != nevent; ++i) {
+        centers.push_back(afwGeom::Point2I(1 + std::rand()%(im.getWidth() - 2),
+                                           1 + std::rand()%(im.getHeight() - 2)));
+    }
+
+    double sum = 0;                     // so that the compiler can't discard the Events
+    double const t0 = bench::now();
+    for (int it = 0; it != niter; ++it) {
+        for (int i = 0; i != nevent; ++i) {
+            ras::Event const ev(im, centers[i], 0, 0, 1000);
+            sum += ev.data[4];
+        }
+    }
+    double const elapsed = bench::now() - t0;
+
+    report(name, elapsed, static_cast<double>(niter)*nevent, static_cast<double>(niter)*nevent*9*sizeof(PixelT));
+    if (sum == 0) {
+        fprintf(stderr, "%s: all events are empty\n", name);
+    }
+}
+}
+
+int
+main(int argc, char **argv)
+{
+    bench::Reporter const report(&argc, argv);
+    int const nevent = (argc > 1) ? atoi(argv[1]) : 1000000;
+    int const niter = (argc > 2) ? atoi(argv[2]) : 10;
+    int const nframe = (argc > 3) ? atoi(argv[3]) : 5;
+
+    std::vector<ras::Event> events = bench::makeEvents(nevent);
+    double const nevents = static_cast<double>(niter)*nevent;
+    double const nbytes = nevents*sizeof(events[0].data);
+    /*
+     * Classification
+     */
+    {
+        HistogramTable table(30, 10, HistogramTable::TNONE, 0.0, ~0, HistogramTable::P_9);
+        table.setPixelType(HistogramTable::FLOAT);
+
+        double t0 = bench::now();
+        for (int it = 0; it != niter; ++it) {
+            for (int j = 0; j != nevent; ++j) {
+                events[j].invalidateClassification();
+                table.classify(&events[j]);
+            }
+        }
+        report("classify", bench::now() - t0, nevents, nbytes);
+
+        t0 = bench::now();
+        for (int it = 0; it != niter; ++it) {
+            for (int j = 0; j != nevent; ++j) {
+                table.classify(&events[j]);
+            }
+        }
+        report("classify.cached", bench::now() - t0, nevents, nbytes);
+
+        t0 = bench::now();
+        for (int it = 0; it != niter; ++it) {
+            for (int j = 0; j != nevent; ++j) {
+                events[j].invalidateClassification();
+                table.process_event(&events[j]);
+            }
+        }
+        report("process_event", bench::now() - t0, nevents, nbytes);
+    }
+    /*
+     * Extracting Events from images
+     */
+    timeEventCtor<float>(report, "Event(ImageF)", nevent, niter);
+    timeEventCtor<boost::uint16_t>(report, "Event(ImageU)", nevent, niter);
+    /*
+     * Reading event files
+     */
+    {
+        std::string const fileName = tempName("events");
+        std::vector<PTR(ras::Event)> evs;
+        evs.reserve(nevent);
+        for (int i = 0; i != nevent; ++i) {
+            evs.push_back(PTR(ras::Event)(new ras::Event(events[i])));
+        }
+        ras::writeEventFile(fileName, evs);
+        evs.clear();
+
+        double const t0 = bench::now();
+        for (int it = 0; it != niter; ++it) {
+            evs = ras::readEventFile(fileName);
+        }
+        report("readEventFile", bench::now() - t0, nevents, nevents*sizeof(data_str));
+        unlink(fileName.c_str());
+    }
+    /*
+     * medpict's burst-mode search; the frames are laid out as format 'a' (ASTD) expects
+     */
+    {
+        int const nx = 560, ny = 512, bias = 1000, nevPerFrame = 1000;
+
+        std::vector<std::string> fileNames;
+        for (int i = 0; i != nframe; ++i) {
+            char what[32];
+            sprintf(what, "frame%d.fits", i);
+            fileNames.push_back(tempName(what));
+            writeFrame(fileNames.back(), nx, ny, bias, nevPerFrame);
+        }
+        std::string const biasFile = tempName("bias.fits");
+        writeFrame(biasFile, nx, ny, bias, 0);
+
+        ras::MedpictConfig config;
+        config.format = ras::MedpictConfig::ASTD;
+        config.evthresh = 30;
+
+        double const npixel = static_cast<double>(niter)*nframe*nx*ny;
+        for (int withBias = 0; withBias != 2; ++withBias) {
+            config.biasFile = withBias ? biasFile : "";
+
+            ras::EventColumns found;
+            double const t0 = bench::now();
+            for (int it = 0; it != niter; ++it) {
+                found.clear();
+                ras::medpictSearch(fileNames, config, found);
+            }
+            report(withBias ? "medpictSearch.biasFile" : "medpictSearch.median",
+                   bench::now() - t0, npixel, npixel*sizeof(int), "pixel");
+            fprintf(stderr, "medpictSearch: %d events in %d frames\n", found.size(), nframe);
+        }
+
+        for (int i = 0; i != nframe; ++i) {
+            unlink(fileNames[i].c_str());
+        }
+        unlink(biasFile.c_str());
+    }
+
+    return 0;
+}
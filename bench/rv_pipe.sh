@@ -0,0 +1,29 @@
+#!/bin/sh
+#
+# Measure the throughput, in events/s, of an rv_gflt | rv_ev2xygpx pipeline
+#
+# Usage: rv_pipe.sh evlist [bindir [niter]]
+#
+# evlist is an RV-format event file; bindir is where to find rv_gflt and rv_ev2xygpx
+# (default: ../bin relative to this script).  Set RV_IO_NEVENT and RV_IO_THREAD to
+# try different block sizes, or synchronous reads
+#
+if [ -z "$1" ]; then
+    echo "Usage: $0 evlist [bindir [niter]]" >&2
+    exit 1
+fi
+evlist=$1
+bindir=${2:-$(dirname $0)/../bin}
+niter=${3:-3}
+
+nevent=$(( $(wc -c < $evlist) / 56 ))	# sizeof(struct data_str)
+
+i=0
+while [ $i -lt $niter ]; do
+    t0=$(date +%s.%N)
+    cat $evlist | $bindir/rv_gflt 30 10 | $bindir/rv_ev2xygpx 30 10 p9 > /dev/null
+    t1=$(date +%s.%N)
+
+    echo "$t0 $t1 $nevent" | awk '{ t = $2 - $1; printf "rv_gflt|rv_ev2xygpx %d events %8.3f s %10.4g events/s\n", $3, t, $3/t }'
+    i=$((i + 1))
+done
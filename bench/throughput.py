@@ -0,0 +1,143 @@
+#!/usr/bin/env python
+"""
+Run the legacy C chain
+    medpict_lsst -b -e | rv_gflt | rv_ev2xygpx
+and the C++ rv_pipeline (and, with --python, bin/fe55 --medpict) on synthetic data sets of several
+sizes made by rv_fe55sim, check that they write the same events, and report each one's wall time,
+peak RSS and throughput (in X-rays injected per second).
+
+bin/fe55 --medpict processes each frame on its own, rather than subtracting the median of all of
+them, so its output is only compared with the legacy chain's for single-frame data sets
+
+The programs are looked for in $RASMUSSEN_DIR (default: the directory above this script).  With
+--json the results are also written as JSON lines in the form that compare.py reads, e.g.
+    throughput.py --json old.json
+    ... change things, rebuild ...
+    throughput.py --json new.json && compare.py old.json new.json
+
+Exits with status 1 if any output differs from the legacy chain's
+"""
+import argparse
+import filecmp
+import glob
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+def run(cmds, stdout):
+    """Run a pipeline of commands (each a list of args), writing the last one's output to stdout
+
+    Return the wall time, and the sum of the processes' peak RSS in kB (they all run at once)
+    """
+    t0 = time.time()
+    procs = []
+    for i, cmd in enumerate(cmds):
+        procs.append(subprocess.Popen(cmd, stdin=(procs[-1].stdout if procs else None),
+                                      stdout=(stdout if i == len(cmds) - 1 else subprocess.PIPE)))
+        if i > 0:
+            procs[-2].stdout.close()    # so procs[-2] sees SIGPIPE if procs[-1] exits
+
+    rss = 0
+    failed = []
+    for cmd, p in zip(cmds, procs):
+        pid, status, rusage = os.wait4(p.pid, 0)
+        p.returncode = status           # stop Popen from trying to reap it
+        rss += rusage.ru_maxrss
+        if status != 0:
+            failed.append(os.path.basename(cmd[0]))
+    elapsed = time.time() - t0
+
+    if failed:
+        raise RuntimeError("%s failed" % " and ".join(failed))
+
+    return elapsed, rss
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--sizes", type=int, nargs="+", default=[1, 4, 16],
+                        help="Numbers of frames in the data sets (default: %(default)s)")
+    parser.add_argument("--nxray", type=int, default=20000, help="Mean number of X-rays per frame")
+    parser.add_argument("--threshold", type=int, default=30, help='Threshold for events ("event")')
+    parser.add_argument("--split", type=int, default=10, help='Threshold for secondary pixels ("split")')
+    parser.add_argument("--grades", type=str, nargs="+", default="0 2 3 4 6".split(), help="Grades to accept")
+    parser.add_argument("--python", action="store_true", help="Also run bin/fe55 --medpict")
+    parser.add_argument("--json", type=str, help="Write the results to this file as JSON lines")
+    parser.add_argument("--workDir", type=str, help="Where to put the data (default: a temporary directory)")
+    parser.add_argument("--keep", action="store_true", help="Don't delete the data and outputs")
+    args = parser.parse_args()
+
+    root = os.environ.get("RASMUSSEN_DIR", os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+    binDir, srcDir = os.path.join(root, "bin"), os.path.join(root, "src")
+
+    workDir = args.workDir or tempfile.mkdtemp(prefix="throughput-")
+    if not os.path.isdir(workDir):
+        os.makedirs(workDir)
+
+    results = []
+    ndiffer = 0
+    try:
+        print "%-8s %-8s %8s %10s %10s %12s  %s" % ("frames", "path", "X-rays", "seconds", "RSS (MB)", "X-rays/s",
+                                                    "output")
+        for nframe in args.sizes:
+            prefix = os.path.join(workDir, "n%d-" % nframe)
+            truth = prefix + "truth"
+            run([[os.path.join(srcDir, "rv_fe55sim"), "-l", "medpict", "-N", str(nframe),
+                  "-n", str(args.nxray), "-S", str(nframe), "-T", truth, "-o", prefix]], None)
+            fileNames = sorted(glob.glob(prefix + "[0-9]*.fits"))
+            nxray = os.path.getsize(truth)//56 # sizeof(struct data_str)
+            nbyte = sum(os.path.getsize(f) for f in fileNames)
+
+            event, split = str(args.threshold), str(args.split)
+            paths = [
+                ("legacy", [[os.path.join(binDir, "medpict_lsst"), "-b", "-f", "e", "-c", "-e"] + fileNames,
+                            [os.path.join(binDir, "rv_gflt"), event, split, "-g"] + args.grades,
+                            [os.path.join(binDir, "rv_ev2xygpx"), event, split, "p9"]]),
+                ("c++",    [[os.path.join(srcDir, "rv_pipeline"), event, split, "-g"] + args.grades +
+                            ["-f", "e", "-c"] + fileNames]),
+                ]
+            if args.python:
+                paths.append(("python", [[os.path.join(binDir, "fe55"), "--medpict", "--calcType", "P_9",
+                                          "--threshold", event, "--split", split, "--grades"] + args.grades +
+                                         ["--outputEventsFile", prefix + "python.out"] + fileNames]))
+
+            for name, cmds in paths:
+                outFile = prefix + name + ".out"
+                with open(os.devnull if name == "python" else outFile, "w") as fd:
+                    elapsed, rss = run(cmds, fd)
+
+                if name == "legacy":
+                    identical = None
+                    status = "reference"
+                elif name == "python" and nframe > 1:
+                    identical = None    # fe55 --medpict doesn't subtract the median of all the frames
+                    status = "not comparable"
+                else:
+                    identical = filecmp.cmp(prefix + "legacy.out", outFile, shallow=False)
+                    status = "identical" if identical else "DIFFERENT"
+                    ndiffer += not identical
+
+                print "%-8d %-8s %8d %10.3f %10.1f %12.4g  %s" % (nframe, name, nxray, elapsed, rss/1024.0,
+                                                                  nxray/elapsed, status)
+                sys.stdout.flush()
+                results.append(dict(name="e2e.%s.%dframes" % (name, nframe), unit="xray", n=nxray,
+                                    seconds=elapsed, ns_per_xray=1e9*elapsed/nxray, xrays_per_s=nxray/elapsed,
+                                    bytes_per_s=nbyte/elapsed, peak_rss_kb=rss, identical=identical))
+    finally:
+        if not args.keep and not args.workDir:
+            shutil.rmtree(workDir)
+        elif args.keep:
+            print >> sys.stderr, "Data and outputs are in %s" % workDir
+
+    if args.json:
+        with open(args.json, "w") as fd:
+            for r in results:
+                print >> fd, json.dumps(r, sort_keys=True)
+
+    return 1 if ndiffer else 0
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -4,6 +4,7 @@
 #include <math.h>
 #include <string.h>
 #include <memory.h>
+#include <sys/resource.h>
 #include "fitsio.h"
 #include "fitsio2.h"
 
@@ -14,6 +15,7 @@
 #define OCHISTOS  150
 #define OCMAX     8
 #define HDR_MAXRCDS 8
+#define NXMAX     8192		/* widest frame; columns past the formats' 2048 aren't imaging or overclock */
 
 enum format {e2v_ccd250,lsst_sta_studycontract,bnl_e2v_studycontract,lbox,astd,berlin,hirefs,raw};
 
@@ -31,18 +33,43 @@ void evaluate_OC_vals
   (int *dp[],int fni,int nx,int ny,int nysample,int ocsample_y[],int noc,
    int nocpix[],int ocsample[][2048],char occLUTAB[],float ocval[][OCMAX]);
 void evaluate_file_OC_vals
-  (fitsfile *ffp[],int fni,int nx,int ny,int nysample,int ocsample_y[],int noc,
+  (int fni,int nx,int ny,int nysample,int ocsample_y[],int noc,
    int nocpix[],int ocsample[][2048],char occLUTAB[],float ocval[][OCMAX]);
 void pushevent(struct data_str *ev,ev_stack **evs);
 void pulldown_events(ev_stack **evs);
 
 char filename[FNMAX][1024]; 
-long filepos[FNMAX]; /* filepos[fi] is 0L when the file is open, IF it is
-		        to be closed later. [filepos shouldn't be used
-			unless trying to emulate `unlimited' number of 
-			descriptors]. If file must be closed, filepos[fi]
-			should be used to record the last position 
-			before closing.*/
+
+/*
+ *  The input files.  At most pool_max of them are open at once (the least
+ *  recently used is closed to make room for another), and rows are read in
+ *  bands of pool_nrow, so a file is opened at most once per band however many
+ *  files there are.  pool_prefetch() reads the next band of every file that
+ *  needs one, starting with the files that are still open.
+ *
+ *  pool_max defaults to the descriptor limit (less some for our outputs), and
+ *  may be set with the environment variable MEDPICT_MAXOPEN.  The bands use
+ *  about MEDPICT_BAND_BYTES (default 64Mb) between them, and hold at most
+ *  MEDPICT_BAND_NROW rows
+ */
+#define POOL_NRESERVE		16		/* descriptors to leave for everything else */
+#define MEDPICT_BAND_BYTES	(64L << 20)
+#define MEDPICT_BAND_NROW	64
+
+static fitsfile *pool_ffp[FNMAX];
+static unsigned long pool_used[FNMAX];	/* pool_clock when the file was last used */
+static unsigned long pool_clock;
+static int pool_nopen,pool_max;
+static int pool_nfile,pool_nx,pool_ny;
+static int pool_nrow;			/* number of rows in a band */
+static int *pool_band[FNMAX];		/* rows pool_row0[fi]..+pool_nband[fi]-1 of file fi */
+static int pool_row0[FNMAX],pool_nband[FNMAX];
+
+static void pool_init(int nfile,int nx,int ny);
+static fitsfile *pool_file(int fi);
+static void pool_prefetch(int row);
+static void pool_read_row(int fi,int row,int *dest);
+static void pool_close(void);
 
 int
 main(int argc,char *argv[])
@@ -57,14 +84,14 @@ main(int argc,char *argv[])
   //  FILE *fp[FNMAX],*fib;
   FILE *fhist[FNMAX],*fevlist[FNMAX];
   int  status=0;
-  fitsfile *ffp[FNMAX],*ffib=NULL,*ffout=NULL;
+  fitsfile *ffib=NULL,*ffout=NULL;
 
   int fni=0,fi,i,nx,ny,npix,burstmode,nev,
        *hist[FNMAX],eventsearch,x,y,xi,yi,evthresh,histmin,histmax,histmode,
        nocpix[OCMAX],ncor[OCMAX],ocsample[OCMAX][2048],ocsample_y[2048],
        OCcorrect[OCMAX][2048],nysample,oc,OCcorrection,noc;
 
-  int ocsLU[2048],occLU[2048];
+  int ocsLU[NXMAX],occLU[NXMAX];
 
   float weight[FNMAX+1],
         ocval[FNMAX][OCMAX];
@@ -175,6 +202,8 @@ main(int argc,char *argv[])
     } else {
       /* it's a filename */
       //      fprintf(stderr,"got filename %s\n",argv[0]);
+      if (fni>=FNMAX)
+	usage("too many files.");
       sprintf(filename[fni],"%s",argv[0]);
       // old way: using FILE descriptors
       //      if ((fp[fni]=fopen(filename[fni],"r"))==NULL) usage("can't open file.");
@@ -184,31 +213,13 @@ main(int argc,char *argv[])
       //      fp[fni]=NULL;
       //      filepos[fni]=0L;
       // 
-      // new way: using fitsfiles
-      if (fits_open_file(&ffp[fni],filename[fni],READONLY,&status))
-	printerror(status);
-      // close file again to keep options open
+      // new way: using fitsfiles, opened when they're needed (see pool_file)
       dp[fni]=NULL;
-      if (fits_close_file(ffp[fni],&status))
-	printerror(status);
-      ffp[fni]=NULL;
-      filepos[fni]=1L;
       evstack[fni]=NULL;
       fni++;
     }
   }
 
-  if (fni<FNMAX-5) { /* arbitrary limit - often csh:limit shows 64 descriptors */
-    /* open the input files and leave them open */
-    for (fi=0;fi<fni;fi++){
-      if (fits_open_file(&ffp[fi],filename[fi],READONLY,&status))
-	printerror(status);
-      //      if ((fp[fi]=fopen(filename[fi],"r"))==NULL)
-      //	usage("can't open file.");
-      filepos[fi]=1L;
-    }
-  }
-
   if ( ! biasout[0] && ! eventsearch && ! histmode ) 
     usage("whats the big idea?");
 
@@ -403,7 +414,7 @@ main(int argc,char *argv[])
   }
 
   /* first make up lookup arrays for OC sampling and also for correcting */
-  for (i=0;i<2048;i++) {    ocsLU[i]=-1;occLU[i]=-1;  }
+  for (i=0;i<NXMAX;i++) {    ocsLU[i]=-1;occLU[i]=-1;  }
   for (oc=0;oc<noc;oc++) {
     /* these LUTs allow faster determination of OC parameters. */
     fprintf(stderr,"for oc %d filling in spaces between %d and %d with %d.\n",oc,ocsample[oc][0],ocsample[oc][nocpix[oc]-1],oc);
@@ -462,14 +473,12 @@ main(int argc,char *argv[])
 
   /* immediately output this to the output file. */
   /*  get size info. from the header */
-  if (fits_open_file(&ffp[0],filename[0],READONLY,&status)) 
-    printerror(status);
 
   if (biasout[0]) {
     //    if (fits_copy_file(ffp[0],ffout,1,1,1,&status))
     //      printerror(status);
     long naxis[2];
-    if (fits_get_img_size(ffp[0],2,naxis,&status)) {
+    if (fits_get_img_size(pool_file(0),2,naxis,&status)) {
       fprintf(stderr,"can't find NAXIS* in this header unit..\n");
       printerror(status);
     }
@@ -492,16 +501,19 @@ main(int argc,char *argv[])
   }
   long naxis[2];
   {
-    if (fits_get_img_size(ffp[0],2,naxis,&status)) {
+    if (fits_get_img_size(pool_file(0),2,naxis,&status)) {
       fprintf(stderr,"can't find NAXIS* in this header unit..\n");
       printerror(status);
     }
     nx=naxis[0];    ny=naxis[1];
     fprintf(stderr,"nx = %d ny = %d\n",nx,ny);
+    if (nx>NXMAX)
+      usage("frames are too wide.");
   }
+  pool_init(fni,nx,ny);
 
   if (input_biasfile[0]) {
-    if (fits_get_img_size(ffp[0],2,naxis,&status)) {
+    if (fits_get_img_size(pool_file(0),2,naxis,&status)) {
       fprintf(stderr,"can't find NAXIS* in this header unit..\n");
       printerror(status);
     }
@@ -514,24 +526,11 @@ main(int argc,char *argv[])
 
   for(fi=1;fi<fni;fi++)  {
 
-    if (ffp[fi]==NULL) { // if file is not open, open it and set it to close
-      if (fits_open_file(&ffp[fi],filename[fi],READONLY,&status))
-	printerror(status);
-      filepos[fi]=0L;
-    }
-
-    if (fits_get_img_size(ffp[fi],2,naxis,&status)) {
+    if (fits_get_img_size(pool_file(fi),2,naxis,&status)) {
       fprintf(stderr,"can't find NAXIS* in this header unit..\n");
       printerror(status);
     }
 
-    if (filepos[fi]==0L) { // close file etc.
-      if (fits_close_file(ffp[fni],&status))
-	printerror(status);
-      ffp[fni]=NULL;
-      filepos[fni]=1L;
-    }
-
     if (nx!=naxis[0]) {
       usage("mis-matching header parameters??");
     }
@@ -573,24 +572,11 @@ main(int argc,char *argv[])
     fprintf(stderr,"will read in %d files..\n",fni);
     for (fi=0;fi<fni;fi++) {
 
-      if (ffp[fi]==NULL) {
-	if (fits_open_file(&ffp[fi],filename[fi],READONLY,&status))
-	  printerror(status);
-	fprintf(stderr,"just opened file %s.. ",filename[fi]);
-	filepos[fi]=0L;
-      }
-      if (fits_read_pix(ffp[fi],TINT,fpixel,(long)nx*ny,NULL,dp[fi],
+      if (fits_read_pix(pool_file(fi),TINT,fpixel,(long)nx*ny,NULL,dp[fi],
 			NULL,&status)) {
 	fprintf(stderr,"can't load the specified file..");
 	printerror(status);
       }
-      if (filepos[fi]==0L) {
-	if (fits_close_file(ffp[fni],&status))
-	  printerror(status);
-	fprintf(stderr,"and closed it (%s)\n",filename[fi]);
-	ffp[fni]=NULL;
-	filepos[fni]=1L;
-      }
       //      fprintf(stderr,"done.\n");
     }
 
@@ -798,7 +784,7 @@ main(int argc,char *argv[])
     /* should do this 3 lines at a time. that way, eventsearch
        and histmode will be possible. probably faster all around too. 
     */
-    int *rp[FNMAX][3],*median_row[3],*tpix,*cpix,*bpix,tmp_med_row[2048];
+    int *rp[FNMAX][3],*median_row[3],*tpix,*cpix,*bpix,tmp_med_row[NXMAX];
     int topindex,cenindex,botindex,row;
     long fpixel[2];
 
@@ -817,7 +803,7 @@ main(int argc,char *argv[])
 	   
       if (OCcorrection) {
 	/* first find the overclock values */
-	evaluate_file_OC_vals(ffp,fni,nx,ny,nysample,ocsample_y,
+	evaluate_file_OC_vals(fni,nx,ny,nysample,ocsample_y,
 			      noc,nocpix,ocsample,occLUTAB,ocval);
 	for (fi=0;fi<fni;fi++)
 	  for (oc=0;oc<noc;oc++)
@@ -829,24 +815,10 @@ main(int argc,char *argv[])
       /* first read in 2 rows for each file. and median the pixels */
       for (row=0;row<2;row++) {
 	fpixel[0]=1L;      fpixel[1]=(long)(row+1);
+	pool_prefetch(row);
 	for (fi=0;fi<fni;fi++) {
 
-	  if (ffp[fi]==NULL) {
-	    if (fits_open_file(&ffp[fi],filename[fi],READONLY,&status))
-	      printerror(status);
-	    filepos[fi]=0L;
-	  }
-	  if (fits_read_pix(ffp[fi],TINT,fpixel,(long)nx,NULL,rp[fi][row],
-			    NULL,&status)) {
-	    fprintf(stderr,"can't load the specified file..");
-	    printerror(status);
-	  }
-	  if (filepos[fi]==0L) {
-	    if (fits_close_file(ffp[fni],&status))
-	      printerror(status);
-	    ffp[fni]=NULL;
-	    filepos[fni]=1L;
-	  }
+	  pool_read_row(fi,row,rp[fi][row]);
 	}
 	     
 	if (fits_read_pix(ffib,TINT,fpixel,(long)nx,NULL,tmp_med_row,
@@ -885,24 +857,10 @@ main(int argc,char *argv[])
 	cenindex=(row-1)%3;
 	botindex=(row-2)%3;
 	
+	pool_prefetch(row);
 	for (fi=0;fi<fni;fi++) {
 
-	  if (ffp[fi]==NULL) {
-	    if (fits_open_file(&ffp[fi],filename[fi],READONLY,&status))
-	      printerror(status);
-	    filepos[fi]=0L;
-	  }
-	  if (fits_read_pix(ffp[fi],TINT,fpixel,(long)nx,NULL,rp[fi][topindex],
-			    NULL,&status)) {
-	    fprintf(stderr,"can't load the specified file..");
-	    printerror(status);
-	  }
-	  if (filepos[fi]==0L) {
-	    if (fits_close_file(ffp[fni],&status))
-	      printerror(status);
-	    ffp[fni]=NULL;
-	    filepos[fni]=1L;
-	  }
+	  pool_read_row(fi,row,rp[fi][topindex]);
 	  
 	}
 	
@@ -1019,7 +977,7 @@ main(int argc,char *argv[])
 
       if (OCcorrection) {
 	/* first find the overclock values */
-	evaluate_file_OC_vals(ffp,fni,nx,ny,nysample,ocsample_y,
+	evaluate_file_OC_vals(fni,nx,ny,nysample,ocsample_y,
 			      noc,nocpix,ocsample,occLUTAB,ocval);
 	for (fi=0;fi<fni;fi++)
 	  for (oc=0;oc<noc;oc++)
@@ -1033,6 +991,7 @@ main(int argc,char *argv[])
       /* first read in 2 rows for each file. and median the pixels */
       for (row=0;row<2;row++) {
 	fpixel[0]=1L;      fpixel[1]=(long)(row+1);
+	pool_prefetch(row);
 	for (fi=0;fi<fni;fi++) {
 	  
 	  //	  if (fp[fi]==NULL) {
@@ -1054,22 +1013,7 @@ main(int argc,char *argv[])
 	
 	  fprintf(stderr,"so far so good (row=%d,fi=%d)\n",row,fi);
 
-	  if (ffp[fi]==NULL) {
-	    if (fits_open_file(&ffp[fi],filename[fi],READONLY,&status))
-	      printerror(status);
-	    filepos[fi]=0L;
-	  }
-	  if (fits_read_pix(ffp[fi],TINT,fpixel,(long)nx,NULL,rp[fi][row],
-			    NULL,&status)) {
-	    fprintf(stderr,"can't load the specified file..");
-	    printerror(status);
-	  }
-	  if (filepos[fi]==0L) {
-	    if (fits_close_file(ffp[fni],&status))
-	      printerror(status);
-	    ffp[fni]=NULL;
-	    filepos[fni]=1L;
-	  }
+	  pool_read_row(fi,row,rp[fi][row]);
 	}
 
 	fprintf(stderr,"so far so good (4) %d %d\n",row,fi);
@@ -1157,6 +1101,7 @@ main(int argc,char *argv[])
 	cenindex=(row-1)%3;
 	botindex=(row-2)%3;
 	
+	pool_prefetch(row);
 	for (fi=0;fi<fni;fi++) {
 	  
 	  //	       if (fp[fi]==NULL) {
@@ -1174,22 +1119,7 @@ main(int argc,char *argv[])
 	  //		 fclose(fp[fi]);
 	  //		 fp[fi]=NULL;
 	  //	       }
-	  if (ffp[fi]==NULL) {
-	    if (fits_open_file(&ffp[fi],filename[fi],READONLY,&status))
-	      printerror(status);
-	    filepos[fi]=0L;
-	  }
-	  if (fits_read_pix(ffp[fi],TINT,fpixel,(long)nx,NULL,rp[fi][topindex],
-			    NULL,&status)) {
-	    fprintf(stderr,"can't load the specified file..");
-	    printerror(status);
-	  }
-	  if (filepos[fi]==0L) {
-	    if (fits_close_file(ffp[fni],&status))
-	      printerror(status);
-	    ffp[fni]=NULL;
-	    filepos[fni]=1L;
-	  }
+	  pool_read_row(fi,row,rp[fi][topindex]);
 	}
 	
 	if (input_biasfile[0]) {
@@ -1369,6 +1299,7 @@ main(int argc,char *argv[])
     if (fits_close_file(ffout,&status))
       printerror(status);
 
+  pool_close();
   if (burstmode)
     for (fi=0;fi<fni;fi++) if (dp[fi]) free(dp[fi]);
   if (histmode)
@@ -1388,6 +1319,7 @@ void median(int x[],int n,int *xmed) {
 	//	sort_uint(n,x);
 	qsort((void*)x,(size_t)n,sizeof(int),comp_int);
 	n2p=(n2=n/2)+1;
+	if (n2p>=n) n2p=n-1;		/* n == 2; don't read past the end of x */
 	*xmed=(n % 2 ? x[n2p] : (int)floor(0.5*(x[n2]+x[n2p])));
 }
 
@@ -1494,11 +1426,10 @@ evaluate_OC_vals
 
 void
 evaluate_file_OC_vals
-  (fitsfile *ffp[],int fni,int nx,int ny,int nysample,int ocsample_y[],int noc,
+  (int fni,int nx,int ny,int nysample,int ocsample_y[],int noc,
    int nocpix[],int ocsample[][2048],char occLUTAB[],float ocval[][OCMAX]   
    /*other than the modified *dp arrays, *ocval[] is the return val.*/
    )
-//fitsfile *ffp[];
 //int fni,nx,ny;
 //int nysample,ocsample_y[],noc,nocpix[],ocsample[][1024];
 //char occLUTAB[];
@@ -1508,7 +1439,7 @@ evaluate_file_OC_vals
   int status=0;
   int min[OCMAX],ochists[OCMAX][OCHISTMAX],psum[OCMAX],nsum[OCMAX],ty,val,
   index;
-  int ocint[FNMAX][OCMAX],line[2048];
+  int ocint[FNMAX][OCMAX],line[NXMAX];
   //long  savepos[FNMAX];
   long fpixel[2];
 
@@ -1535,22 +1466,7 @@ evaluate_file_OC_vals
     fpixel[0]=1L;
     fpixel[1]=(long)(ty+1);
 
-    if (ffp[fi]==NULL) {
-      if (fits_open_file(&ffp[fi],filename[fi],READONLY,&status))
-	printerror(status);
-      filepos[fi]=0L;
-    }
-    if (fits_read_pix(ffp[fi],TINT,fpixel,(long)nx,NULL,line,
-		      NULL,&status)) {
-      fprintf(stderr,"can't load the specified file..");
-      printerror(status);
-    }
-    if (filepos[fi]==0L) {
-      if (fits_close_file(ffp[fni],&status))
-	printerror(status);
-      ffp[fni]=NULL;
-      filepos[fni]=1L;
-    }
+    pool_read_row(fi,ty,line);
     
     for (oc=0;oc<noc;oc++) { psum[oc]=0; nsum[oc]=0;  }
     for (oc=0;oc<noc;oc++) {
@@ -1577,22 +1493,7 @@ evaluate_file_OC_vals
       fpixel[0]=1L;
       fpixel[1]=(long)(ty+1);
       //      fread(line,sizeof(int),nx,fp[fi]);
-      if (ffp[fi]==NULL) {
-	if (fits_open_file(&ffp[fi],filename[fi],READONLY,&status))
-	  printerror(status);
-	filepos[fi]=0L;
-      }
-      if (fits_read_pix(ffp[fi],TINT,fpixel,(long)nx,NULL,line,
-			NULL,&status)) {
-	fprintf(stderr,"can't load the specified file..");
-	printerror(status);
-      }
-      if (filepos[fi]==0L) {
-	if (fits_close_file(ffp[fni],&status))
-	  printerror(status);
-	ffp[fni]=NULL;
-	filepos[fni]=1L;
-      }
+      pool_read_row(fi,ty,line);
 
       for (oc=0;oc<noc;oc++) {
 	index=ocsample[oc][0];
@@ -1648,6 +1549,154 @@ evaluate_file_OC_vals
   }
 }
 
+/*
+ *  The number of input files that we may hold open at once
+ */
+static int
+pool_max_open(void)
+{
+  const char *val=getenv("MEDPICT_MAXOPEN");
+  struct rlimit rl;
+  int nmax=FNMAX;
+
+  if (val)
+    nmax=atoi(val);
+  else if (getrlimit(RLIMIT_NOFILE,&rl)==0 && rl.rlim_cur!=RLIM_INFINITY &&
+	   rl.rlim_cur<FNMAX+POOL_NRESERVE)
+    nmax=(int)rl.rlim_cur-POOL_NRESERVE;
+  return (nmax<1 ? 1 : nmax);
+}
+
+/*
+ *  Choose the size of the row bands, now that we know how many files
+ *  there are and how big they are
+ */
+static void
+pool_init(int nfile,int nx,int ny)
+{
+  const char *val;
+  long nbyte=MEDPICT_BAND_BYTES;
+  int nrowmax=MEDPICT_BAND_NROW;
+
+  if ((val=getenv("MEDPICT_BAND_BYTES"))) nbyte=atol(val);
+  if ((val=getenv("MEDPICT_BAND_NROW"))) nrowmax=atoi(val);
+
+  pool_nfile=nfile; pool_nx=nx; pool_ny=ny;
+  pool_nrow=(int)(nbyte/((long)nfile*nx*sizeof(int)));
+  if (pool_nrow>nrowmax) pool_nrow=nrowmax;
+  if (pool_nrow>ny)      pool_nrow=ny;
+  if (pool_nrow<1)       pool_nrow=1;
+
+  fprintf(stderr,"reading %d files in bands of %d rows, with at most %d open\n",
+	  nfile,pool_nrow,(pool_max ? pool_max : pool_max_open()));
+}
+
+/*
+ *  Return a handle on file fi, opening it (and closing the least recently
+ *  used file, if we have too many open) if need be
+ */
+static fitsfile *
+pool_file(int fi)
+{
+  int status=0,i,lru;
+
+  pool_used[fi]=++pool_clock;
+  if (pool_ffp[fi])
+    return pool_ffp[fi];
+
+  if (pool_max==0)
+    pool_max=pool_max_open();
+  if (pool_nopen>=pool_max) {
+    lru=-1;
+    for (i=0;i<FNMAX;i++)
+      if (pool_ffp[i] && (lru<0 || pool_used[i]<pool_used[lru])) lru=i;
+    if (fits_close_file(pool_ffp[lru],&status))
+      printerror(status);
+    pool_ffp[lru]=NULL;
+    pool_nopen--;
+  }
+
+  if (fits_open_file(&pool_ffp[fi],filename[fi],READONLY,&status))
+    printerror(status);
+  pool_nopen++;
+
+  return pool_ffp[fi];
+}
+
+/*
+ *  Read the band of rows starting at row into file fi's band buffer
+ */
+static void
+pool_fill(int fi,int row)
+{
+  int status=0,n;
+  long fpixel[2];
+
+  if (pool_band[fi]==NULL &&
+      (pool_band[fi]=(int*)malloc((size_t)pool_nrow*pool_nx*sizeof(int)))==NULL)
+    usage("can't allocate band array.");
+
+  n=(row+pool_nrow<=pool_ny ? pool_nrow : pool_ny-row);
+  fpixel[0]=1L;      fpixel[1]=(long)(row+1);
+  if (fits_read_pix(pool_file(fi),TINT,fpixel,(long)n*pool_nx,NULL,pool_band[fi],
+		    NULL,&status)) {
+    fprintf(stderr,"can't load the specified file..");
+    printerror(status);
+  }
+  pool_row0[fi]=row;
+  pool_nband[fi]=n;
+}
+
+#define POOL_HAVE_ROW(fi,row) \
+  (pool_band[fi] && (row)>=pool_row0[fi] && (row)<pool_row0[fi]+pool_nband[fi])
+
+/*
+ *  Make sure that every file's band includes row, reading the files that are
+ *  already open before those that we'll have to (re)open
+ */
+static void
+pool_prefetch(int row)
+{
+  int fi,pass;
+
+  for (pass=0;pass<2;pass++)
+    for (fi=0;fi<pool_nfile;fi++)
+      if (!POOL_HAVE_ROW(fi,row) && (pass==1 || pool_ffp[fi]!=NULL))
+	pool_fill(fi,row);
+}
+
+/*
+ *  Copy row of file fi into dest
+ */
+static void
+pool_read_row(int fi,int row,int *dest)
+{
+  if (!POOL_HAVE_ROW(fi,row))
+    pool_fill(fi,row);
+  memcpy(dest,pool_band[fi]+(size_t)(row-pool_row0[fi])*pool_nx,pool_nx*sizeof(int));
+}
+
+/*
+ *  Close all the files, and release the bands
+ */
+static void
+pool_close(void)
+{
+  int status=0,fi;
+
+  for (fi=0;fi<FNMAX;fi++) {
+    if (pool_ffp[fi]) {
+      fits_close_file(pool_ffp[fi],&status);
+      pool_ffp[fi]=NULL;
+    }
+    if (pool_band[fi]) {
+      free(pool_band[fi]);
+      pool_band[fi]=NULL;
+    }
+  }
+  pool_nopen=0;
+}
+
 void
 pushevent(struct data_str *ev,ev_stack **evs) 
 {
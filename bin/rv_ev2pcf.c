@@ -18,53 +18,22 @@
 #include <string.h>
 #include <unistd.h>
 #include "lsst/rasmussen/rv.h"
+#include "lsst/rasmussen/grades.h"
+#include "lsst/rasmussen/rvio.h"
 
-#define EVENTS 		1024
 #define MAXADU 		4096
 #define EXTADU		8
 #define NAMLEN		512
 
-struct data_str eventdata[EVENTS];
-struct look_up { int *type, *extr, *hist; } table[256];
+struct rv_reader evin;
 
-int		nsngle,nsplus,npvert,npleft,nprght,npplus,
-		nelnsq,nother,ntotal,noobnd,nbevth;
-int		extra[][4] = {  {4,4,4,4},
-				{0,4,4,4}, {2,4,4,4}, {6,4,4,4}, {8,4,4,4},
-				{0,2,4,4}, {0,6,4,4}, {6,8,4,4}, {8,2,4,4},
-				{0,2,6,8} };
-unsigned char	emask[] = { 0x00,
-			    0x0a,0x12,0x48,0x50,
-			    0x1a,0x4a,0x58,0x52,
-			    0x5a };
+int		ngrade[8],ntotal,noobnd,nbevth;
 int		histo[8][MAXADU], oldfrnum = 0,
 		cnt = 0, ev_min = MAXADU, xav = 0, yav = 0;
 short		min_adu = MAXADU, max_adu = 0;
 short		min_2ct = MAXADU, max_2ct = 0;
 short		xn = 512, xx = 0, yn = 512, yx = 0;
 
-unsigned char	sngle[] = { 0x00 }; 					/* 0 */
-unsigned char	splus[] = { 0x01,0x04,0x20,0x80,0x05,0x21,0x81,		/* 1 */
-			    0x24,0x84,0xa0,0x25,0x85,0xa4,0xa1,0xa5 };
-unsigned char	pvert[] = { 0x02,0x40,0x22,0x82,0x41,0x44,0x45,0xa2 };	/* 2 */
-unsigned char	pleft[] = { 0x08,0x0c,0x88,0x8c };			/* 3 */
-unsigned char	prght[] = { 0x10,0x30,0x11,0x31 };			/* 4 */
-/*
- *  gned char	phorz[] = { 0x08,0x10,0x0c,0x88,0x30,0x11,0x8c,0x31 };
- */
-
-unsigned char	pplus[] = { 0x03,0x06,0x09,0x28,0x60,0xc0,0x90,0x14,	/* 5 */
-			    0x83,0x26,0x89,0x2c,0x64,0xc1,0x91,0x34,
-			    0x23,0x86,0x0d,0xa8,0x61,0xc4,0xb0,0x15,
-			    0xa3,0xa6,0x8d,0xac,0x65,0xc5,0xb1,0x35 };
-/*
- *  gned char	elish[] = { 0x12,0x32,0x50,0x51,0x48,0x4c,0x0a,0x8a };
- *  gned char	squar[] = { 0x16,0xd0,0x68,0x0b,0x36,0xd1,0x6c,0x8b };
- */
-unsigned char	elnsq[] = { 0x12,0x32,0x50,0x51,0x48,0x4c,0x0a,0x8a,	/* 6 */
-			    0x16,0xd0,0x68,0x0b,0x36,0xd1,0x6c,0x8b };
-
-unsigned char	other[256] /* = { all of the rest } */;			/* 7 */
 char		efile[NAMLEN];
 
 
@@ -108,124 +77,26 @@ usage()
 static void
 dump_table()
 {
-	register int		i, j;
+	register int		i;
 
 	for (i = 0; i < 256; i++) {
-
-		if ( table[i].type == &nsngle )  j = 0;	else
-		if ( table[i].type == &nsplus )  j = 1;	else
-		if ( table[i].type == &npvert )  j = 2;	else
-		if ( table[i].type == &npleft )  j = 3;	else
-		if ( table[i].type == &nprght )  j = 4;	else
-		if ( table[i].type == &npplus )  j = 5;	else
-		if ( table[i].type == &nelnsq )  j = 6;	else
-		if ( table[i].type == &nother )  j = 7;	else
-						 j = 9;
-
-		(void)fprintf(stderr, "%d,", j);
+		(void)fprintf(stderr, "%d,", rv_grades[i].grade);
 		if (i%16 == 15) (void)fprintf(stderr, "\n");
 	}
 }
 
 /*
- *  Initialize the histogram tables.  Each entry of the table needs
- *  to know which counter to increment, which histogram to increment
- *  and which extra pixels should be included in the summed pha,
- *  which only occurs for the L, Q and Other grades.
+ *  Initialize the histogram tables.  The grade of each map, and the
+ *  extra pixels that should be included in the summed pha (which only
+ *  occurs for the L, Q and Other grades) are in rv_grades (grades.h)
  */
 static void
 prep_hist()
 {
-	register int		i;
-	register struct look_up	*t;
-	unsigned char		b;
-	int			j;
-
 	/* zero everything in sight */
-	nsngle = nsplus = npvert = npleft = nprght = npplus =
-		 nelnsq = nother = ntotal = noobnd = nbevth = 0;
+	bzero((char *)ngrade, sizeof(ngrade));
+	ntotal = noobnd = nbevth = 0;
 	bzero((char *)histo, sizeof(histo));
-
-	/* load the sngle events into table GRADE 0 */
-	for (i = 0; i < sizeof(sngle); i++) {
-		t = table + sngle[i];
-		t->type = &nsngle;
-		t->hist = histo[0];
-		t->extr = extra[0];	
-	}
-
-	/* load the splus events into table GRADE 1 */
-	for (i = 0; i < sizeof(splus); i++) {
-		t = table + splus[i];
-		t->type = &nsplus;
-		t->hist = histo[1];
-		t->extr = extra[0];	
-	}
-
-	/* load the pvert events into table GRADE 2 */
-	for (i = 0; i < sizeof(pvert); i++) {
-		t = table + pvert[i];
-		t->type = &npvert;
-		t->hist = histo[2];
-		t->extr = extra[0];	
-	}
-
-	/* load the pleft events into table GRADE 3 */
-	for (i = 0; i < sizeof(pleft); i++) {
-		t = table + pleft[i];
-		t->type = &npleft;
-		t->hist = histo[3];
-		t->extr = extra[0];	
-	}
-
-	/* load the prght events into table GRADE 4 */
-	for (i = 0; i < sizeof(prght); i++) {
-		t = table + prght[i];
-		t->type = &nprght;
-		t->hist = histo[4];
-		t->extr = extra[0];	
-	}
-
-	/* load the pplus events into table GRADE 5 */
-	for (i = 0; i < sizeof(pplus); i++) {
-		t = table + pplus[i];
-		t->type = &npplus;
-		t->hist = histo[5];
-		t->extr = extra[0];	
-	}
-
-	/* load the elnsq events into table GRADE 6 */
-	for (i = 0; i < sizeof(elnsq); i++) {
-		t = table + elnsq[i];
-		t->type = &nelnsq;
-		t->hist = histo[6];
-		t->extr = extra[0];	
-		for (b = 0x5a & elnsq[i], j = 0; j < sizeof(emask); j++)
-			if (b == emask[j]) {
-				t->extr = extra[j];
-				break;
-			}
-	}
-
-	/* load the other events into table GRADE 7 */
-	for (i = 0; i < sizeof(other); i++) {
-		t = table + i;
-		if (t->type) continue;		/* already loaded */
-		t->type = &nother;
-		t->hist = histo[7];
-		t->extr = extra[0];	
-		/*
-		 *  In this version, included corners are
-		 *  ignored in all of the grade 7 events.
-		 *
-		for (b = 0x5a & (unsigned char)i, j = 0;
-			j < sizeof(emask); j++)
-			if (b == emask[j]) {
-				t->extr = extra[j];
-				break;
-			}
-		*/
-	}
 }
 
 /*
@@ -243,8 +114,8 @@ make_hist(int event,
 	register unsigned char	map;
 	register int		j;
 	short			phj, sum, phe[9], hsum;
-	struct look_up		*ent;
-	int			*xtr;
+	int			grade;
+	unsigned char		xtr;
 
 	for ( ; num--; ev++) {
 		/*
@@ -295,9 +166,10 @@ make_hist(int event,
 		/*
 		 *  Finish pha with extra pixels of L, Q, and O events
 		 */
-		ent = &table[map];
-		xtr = ent->extr;
-		for (j = 0; xtr[j] != 4 && j < 4; j++) sum += phe[xtr[j]];
+		grade = rv_grades[map].grade;
+		if ((xtr = rv_grades[map].extra))
+			for (j = 0; j < 4; j++)
+				if (xtr & rv_corner_bit[j]) sum += phe[rv_corner_pixel[j]];
 		/*
 		 *  Accumulate statistics and various bounds
 		 */
@@ -311,8 +183,8 @@ make_hist(int event,
 		xav += ev->x;
 		yav += ev->y;
 		ntotal += 1;
-		*ent->type += 1;
-		hsum = ent->hist[sum] += 1;
+		ngrade[grade] += 1;
+		hsum = histo[grade][sum] += 1;
 		if (hsum > 2) {
 			if (sum > max_2ct) max_2ct = sum;
 			if (sum < min_2ct) min_2ct = sum;
@@ -416,7 +288,8 @@ dump_hist(int event, int split, const char *sfile)
 	(void)fprintf(stdout, "!\n");
 	(void)fprintf(stdout, "!  PHA\tS\tS+\tPv\tPl\tPr\tP+\tL+Q\tO\n");
 	(void)fprintf(stdout, "!  TOT\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\n",
-		nsngle,nsplus,npvert,npleft,nprght,npplus,nelnsq,nother);
+		ngrade[0],ngrade[1],ngrade[2],ngrade[3],
+		ngrade[4],ngrade[5],ngrade[6],ngrade[7]);
 	(void)fprintf(stdout, "!\n");
 
 	min_adu = (  min_adu <        EXTADU) ?      0 : min_adu - EXTADU;
@@ -435,6 +308,7 @@ main(int argc,
     )
 {
 	int	event, split, num, tot = 0;
+	struct data_str *events;
 	const char *sfile = "unknown";
         char    def_style = '1', *style = &def_style;
 	double	reset = 0;
@@ -457,11 +331,13 @@ main(int argc,
 	}
 
 	prep_hist();
-	const int nread = 1000;		/* number of events to read at a time */
-	while ((num = fread((void *)eventdata, sizeof(struct data_str), nread, stdin)) > 0) {
+	if (rv_reader_open(&evin, 0) < 0) { perror("rv_reader_open"); return(1); }
+	while ((num = rv_read_events(&evin, &events)) > 0) {
 		tot += num;
-		make_hist(event, split, num, eventdata, reset, style);
+		make_hist(event, split, num, events, reset, style);
 	}
+	if (rv_reader_error(&evin) < 0) { perror("rv_ev2pcf"); return(1); }
+	rv_reader_close(&evin);
 	dump_head(sfile, event, split, tot);
 	dump_hist(event, split, sfile);
 	return(0);
@@ -22,63 +22,28 @@
 #include <string.h>
 #include <unistd.h>
 #include "lsst/rasmussen/rv.h"
+#include "lsst/rasmussen/grades.h"
+#include "lsst/rasmussen/rvio.h"
 
-#define EVENTS 		1024
 #define MAXADU 		4096
 #define EXTADU		8
 #define NAMLEN		512
 
-struct data_str eventdata[EVENTS];
-struct look_up { int *type, *extr, *hist; } table[256];
+struct rv_reader evin;
+struct rv_writer evout;
 
-int		nsngle,nsplus,npvert,npleft,nprght,npplus,
-		nelnsq,nother,ntotal,noobnd,nbevth;
-int		extra[][4] = {  {4,4,4,4},
-				{0,4,4,4}, {2,4,4,4}, {6,4,4,4}, {8,4,4,4},
-				{0,2,4,4}, {0,6,4,4}, {6,8,4,4}, {8,2,4,4},
-				{0,2,6,8} };
-unsigned char	emask[] = { 0x00,
-			    0x0a,0x12,0x48,0x50,
-			    0x1a,0x4a,0x58,0x52,
-			    0x5a };
+int		ngrade[8],ntotal,noobnd,nbevth;
 int		histo[8][MAXADU], oldfrnum = 0,
 		cnt = 0, ev_min = MAXADU, xav = 0, yav = 0;
 short		min_adu = MAXADU, max_adu = 0;
 short		min_2ct = MAXADU, max_2ct = 0;
 short		xn = 512, xx = 0, yn = 512, yx = 0;
 
-unsigned char	sngle[] = { 0x00 }; 					/* 0 */
-unsigned char	splus[] = { 0x01,0x04,0x20,0x80,0x05,0x21,0x81,		/* 1 */
-			    0x24,0x84,0xa0,0x25,0x85,0xa4,0xa1,0xa5 };
-unsigned char	pvert[] = { 0x02,0x40,0x22,0x82,0x41,0x44,0x45,0xa2 };	/* 2 */
-unsigned char	pleft[] = { 0x08,0x0c,0x88,0x8c };			/* 3 */
-unsigned char	prght[] = { 0x10,0x30,0x11,0x31 };			/* 4 */
-/*
- *  gned char	phorz[] = { 0x08,0x10,0x0c,0x88,0x30,0x11,0x8c,0x31 };
- */
-//unsigned char	pplus[] = { 0xc0,0x60,0x90,0x14,0x03,0x06,0x09,0x28,	/* 5 */
-//			    0x86,0x83,0x15,0x0d,0x89,0x8d,0xc4,0xc1,
-//			    0xc5,0x26,0xa6,0x23,0xa3,0x34,0xa8,0x35,
-//			    0xa9,0x2c,0xa8,0xac,0x64,0x61,0x65 };
-
-unsigned char	pplus[] = { 0x03,0x06,0x09,0x28,0x60,0xc0,0x90,0x14,	/* 5 */
-			    0x83,0x26,0x89,0x2c,0x64,0xc1,0x91,0x34,
-			    0x23,0x86,0x0d,0xa8,0x61,0xc4,0xb0,0x15,
-			    0xa3,0xa6,0x8d,0xac,0x65,0xc5,0xb1,0x35 };
-/*
- *  gned char	elish[] = { 0x12,0x32,0x50,0x51,0x48,0x4c,0x0a,0x8a };
- *  gned char	squar[] = { 0x16,0xd0,0x68,0x0b,0x36,0xd1,0x6c,0x8b };
- */
-unsigned char	elnsq[] = { 0x12,0x32,0x50,0x51,0x48,0x4c,0x0a,0x8a,	/* 6 */
-			    0x16,0xd0,0x68,0x0b,0x36,0xd1,0x6c,0x8b };
-
-unsigned char	other[256] /* = { all of the rest } */;			/* 7 */
 unsigned char   grades[] = { 0x01,0x02,0x04,0x08,0x10,0x20,0x40,0x80 };
 
 char		efile[NAMLEN];
 
-int nacc, nnoto;
-unsigned char accmap[256], notomap[256], filter=0xff;
+unsigned char filter=0xff;
 
 int     phlo=0,phhi=4095;
 
@@ -112,104 +77,17 @@ usage()
 }
 
 /*
- *  Initialize the histogram tables.  Each entry of the table needs
- *  to know which counter to increment, which histogram to increment
- *  and which extra pixels should be included in the summed pha,
- *  which only occurs for the L, Q and Other grades.
+ *  Initialize the histogram tables.  The grade of each map, and the
+ *  extra pixels that should be included in the summed pha (which only
+ *  occurs for the L, Q and Other grades) are in rv_grades (grades.h)
  */
 static void
 prep_hist()
 {
-	register int		i;
-	register struct look_up	*t;
-	unsigned char		b;
-	int			j;
-
 	/* zero everything in sight */
-	nsngle = nsplus = npvert = npleft = nprght = npplus =
-		 nelnsq = nother = ntotal = noobnd = nbevth = 0;
+	bzero((char *)ngrade, sizeof(ngrade));
+	ntotal = noobnd = nbevth = 0;
 	bzero((char *)histo, sizeof(histo));
-
-	/* load the sngle events into table GRADE 0 */
-	for (i = 0; i < sizeof(sngle); i++) {
-		t = table + sngle[i];
-		t->type = &nsngle;
-		t->hist = histo[0];
-		t->extr = extra[0];	
-	}
-
-	/* load the splus events into table GRADE 1 */
-	for (i = 0; i < sizeof(splus); i++) {
-		t = table + splus[i];
-		t->type = &nsplus;
-		t->hist = histo[1];
-		t->extr = extra[0];	
-	}
-
-	/* load the pvert events into table GRADE 2 */
-	for (i = 0; i < sizeof(pvert); i++) {
-		t = table + pvert[i];
-		t->type = &npvert;
-		t->hist = histo[2];
-		t->extr = extra[0];	
-	}
-
-	/* load the pleft events into table GRADE 3 */
-	for (i = 0; i < sizeof(pleft); i++) {
-		t = table + pleft[i];
-		t->type = &npleft;
-		t->hist = histo[3];
-		t->extr = extra[0];	
-	}
-
-	/* load the prght events into table GRADE 4 */
-	for (i = 0; i < sizeof(prght); i++) {
-		t = table + prght[i];
-		t->type = &nprght;
-		t->hist = histo[4];
-		t->extr = extra[0];	
-	}
-
-	/* load the pplus events into table GRADE 5 */
-	for (i = 0; i < sizeof(pplus); i++) {
-		t = table + pplus[i];
-		t->type = &npplus;
-		t->hist = histo[5];
-		t->extr = extra[0];	
-	}
-
-	/* load the elnsq events into table GRADE 6 */
-	for (i = 0; i < sizeof(elnsq); i++) {
-		t = table + elnsq[i];
-		t->type = &nelnsq;
-		t->hist = histo[6];
-		t->extr = extra[0];	
-		for (b = 0x5a & elnsq[i], j = 0; j < sizeof(emask); j++)
-			if (b == emask[j]) {
-				t->extr = extra[j];
-				break;
-			}
-	}
-
-	/* load the other events into table GRADE 7 */
-	for (i = 0; i < sizeof(other); i++) {
-		t = table + i;
-		if (t->type) continue;		/* already loaded */
-		t->type = &nother;
-		t->hist = histo[7];
-		t->extr = extra[0];	
-		/*
-		 *  In this version, included corners are
-		 *  ignored in all of the grade 7 events.
-		 *
-		for (b = 0x5a & (unsigned char)i, j = 0;
-			j < sizeof(emask); j++)
-			if (b == emask[j]) {
-				t->extr = extra[j];
-				break;
-			}
-		*/
-	}
 }
 
 /*
@@ -227,8 +105,8 @@ make_hist(int event,
 	register unsigned char	map;
 	register int		j;
 	short			phj, sum, phe[9], hsum;
-	struct look_up		*ent;
-	int			*xtr;
+	int			grade;
+	unsigned char		xtr;
 
 	for ( ; num--; ev++) {
 		/*
@@ -285,27 +163,14 @@ make_hist(int event,
 		 *  to pass it on or not.
 		 *
 		 */
-
-		for (j=0;j<nacc;j++) 
-		  {
-		    if (map == accmap[j]) 
-		      goto accept_event;
-		  }
-		if (filter & 0x80) 
-		  {
-		    for (j=0;j<nnoto;j++) 
-		      if (map == notomap[j]) goto nextevent;
-		    goto accept_event;
-		  }
-	nextevent: 
-		continue;
-	accept_event:
+		grade = rv_grades[map].grade;
+		if (!(filter & grades[grade])) continue;
 		/*
 		 *  Finish pha with extra pixels of L, Q, and O events
 		 */
-		ent = &table[map];
-		xtr = ent->extr;
-		for (j = 0; xtr[j] != 4 && j < 4; j++) sum += phe[xtr[j]];
+		if ((xtr = rv_grades[map].extra))
+			for (j = 0; j < 4; j++)
+				if (xtr & rv_corner_bit[j]) sum += phe[rv_corner_pixel[j]];
 		/*
 		 *  Accumulate statistics and various bounds
 		 */
@@ -319,14 +184,14 @@ make_hist(int event,
 		xav += ev->x;
 		yav += ev->y;
 		ntotal += 1;
-		*ent->type += 1;
-		hsum = ent->hist[sum] += 1;
+		ngrade[grade] += 1;
+		hsum = histo[grade][sum] += 1;
 		if (hsum > 2) {
 			if (sum > max_2ct) max_2ct = sum;
 			if (sum < min_2ct) min_2ct = sum;
 		}
 		if ((sum>=phlo) && (sum<phhi)) 
-		  write(1,ev,sizeof(struct data_str));
+		  rv_write_events(&evout, ev, 1);
 	}
 }
 
@@ -422,7 +287,8 @@ dump_hist(int event, int split, char *sfile)
 	(void)fprintf(stdout, "!\n");
 	(void)fprintf(stdout, "!  PHA\tS\tS+\tPv\tPl\tPr\tP+\tL+Q\tO\n");
 	(void)fprintf(stdout, "!  TOT\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\n",
-		nsngle,nsplus,npvert,npleft,nprght,npplus,nelnsq,nother);
+		ngrade[0],ngrade[1],ngrade[2],ngrade[3],
+		ngrade[4],ngrade[5],ngrade[6],ngrade[7]);
 	(void)fprintf(stdout, "!\n");
 
 	min_adu = (  min_adu <        EXTADU) ?      0 : min_adu - EXTADU;
@@ -437,7 +303,8 @@ dump_hist(int event, int split, char *sfile)
 int
 main(int argc, char **argv)
 {
-	int	event, split, num, gr, i, k, tot = 0;
+	int	event, split, num, gr, tot = 0;
+	struct data_str *events;
 	char	style[256];
 	double	reset=0;
 
@@ -484,70 +351,17 @@ main(int argc, char **argv)
 	  }
 	}
 
-	/* make up the array of acceptable maps. */
-
-	for (i=0;i<256;i++) accmap[i]=0;
-	nacc=0;
-
-	if (filter & 0x01) 
-	  {
-	    for (k=0;k<sizeof(sngle);k++) accmap[nacc+k]=sngle[k];
-	    nacc+=sizeof(sngle); 
-	  }
-	if (filter & 0x02) 
-	  {
-	    for (k=0;k<sizeof(splus);k++) accmap[nacc+k]=splus[k];
-	    nacc+=sizeof(splus); 
-	  }
-	if (filter & 0x04) 
-	  {
-	    for (k=0;k<sizeof(pvert);k++) accmap[nacc+k]=pvert[k];
-	    nacc+=sizeof(pvert); 
-	  }
-	if (filter & 0x08) 
-	  {
-	    for (k=0;k<sizeof(pleft);k++) accmap[nacc+k]=pleft[k];
-	    nacc+=sizeof(pleft); 
-	  }
-	if (filter & 0x10) 
-	  {
-	    for (k=0;k<sizeof(prght);k++) accmap[nacc+k]=prght[k];
-	    nacc+=sizeof(prght); 
-	  }
-	if (filter & 0x20) 
-	  {
-	    for (k=0;k<sizeof(pplus);k++) accmap[nacc+k]=pplus[k];
-	    nacc+=sizeof(pplus); 
-	  }
-	if (filter & 0x40) 
-	  {
-	    for (k=0;k<sizeof(elnsq);k++) accmap[nacc+k]=elnsq[k];
-	    nacc+=sizeof(elnsq); 
-	  }
-	/* need to make a `not others' array. */
-	    nnoto=0;
-	    for (k=0;k<sizeof(sngle);k++) notomap[nnoto+k]=sngle[k];
-	    nnoto+=sizeof(sngle);
-	    for (k=0;k<sizeof(splus);k++) notomap[nnoto+k]=splus[k];
-	    nnoto+=sizeof(splus);
-	    for (k=0;k<sizeof(pvert);k++) notomap[nnoto+k]=pvert[k];
-	    nnoto+=sizeof(pvert);
-	    for (k=0;k<sizeof(pleft);k++) notomap[nnoto+k]=pleft[k];
-	    nnoto+=sizeof(pleft);
-	    for (k=0;k<sizeof(prght);k++) notomap[nnoto+k]=prght[k];
-	    nnoto+=sizeof(prght);
-	    for (k=0;k<sizeof(pplus);k++) notomap[nnoto+k]=pplus[k];
-	    nnoto+=sizeof(pplus);
-	    for (k=0;k<sizeof(elnsq);k++) notomap[nnoto+k]=elnsq[k];
-	    nnoto+=sizeof(elnsq);
-	
 /* ready for the data now. */
 	prep_hist();
-	const int nread = 1000;		/* number of events to read at a time */
-	while ((num = fread((void *)eventdata, sizeof(struct data_str), nread, stdin)) > 0) {
+	if (rv_reader_open(&evin, 0) < 0) { perror("rv_reader_open"); return(1); }
+	if (rv_writer_open(&evout, 1) < 0) { perror("rv_writer_open"); return(1); }
+	while ((num = rv_read_events(&evin, &events)) > 0) {
 		tot += num;
-		make_hist(event, split, num, eventdata, reset, style);
+		make_hist(event, split, num, events, reset, style);
 	}
+	if (rv_reader_error(&evin) < 0) { perror("rv_gflt"); return(1); }
+	rv_reader_close(&evin);
+	if (rv_writer_close(&evout) < 0) { perror("rv_gflt"); return(1); }
 	return(0);
 /*	dump_head(sfile, event, split, tot); */
 /*	dump_hist(event, split, sfile);      */
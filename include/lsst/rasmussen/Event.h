@@ -17,6 +17,30 @@ namespace lsst {
         }
     }
     namespace rasmussen {
+        /*
+         * Everything that an Event's classification (grade, sum, p9, flags) depends on, as set in the
+         * HistogramTable that classified it.  The grade filter and event threshold aren't part of the key,
+         * so a table that differs from another only in those can reuse its classifications
+         */
+        struct ClassificationKey {
+            ClassificationKey() : split(0), resetStyle(-1), resetCoeff(0.0), calctype(-1), pixelType(-1),
+                                  saturation(0.0) {}
+
+            bool isValid() const { return resetStyle >= 0; } // false for a default-constructed key
+
+            bool operator==(ClassificationKey const& rhs) const {
+                return split == rhs.split && resetStyle == rhs.resetStyle && resetCoeff == rhs.resetCoeff &&
+                    calctype == rhs.calctype && pixelType == rhs.pixelType && saturation == rhs.saturation;
+            }
+            bool operator!=(ClassificationKey const& rhs) const { return !(*this == rhs); }
+
+            int split;                  ///< split threshold
+            int resetStyle;             ///< HistogramTable::RESET_STYLES
+            double resetCoeff;          ///< reset clock correction coefficient
+            int calctype;               ///< HistogramTable::calctype
+            int pixelType;              ///< HistogramTable::pixeltype
+            double saturation;          ///< saturation level
+        };
 
         class Event : public data_str {
         public:
@@ -31,20 +55,47 @@ namespace lsst {
                          ELL_SQUARE_P_CORNER=6,   ///< L or square (+ detached corner)
                          OTHER=7                  ///< all others
             };
+            // Problems found while extracting or classifying the Event
+            enum Flags { SATURATED=0x1,      ///< a pixel is at or above the saturation level
+                         OVERFLOWED=0x2,     ///< a pixel can't be represented by the classifier's pixel type
+                         EDGE=0x4            ///< some pixels were off the image (see EventExtractor::FLAG)
+            };
 
-            Event(data_str const& ds) : data_str(ds), grade(UNKNOWN), sum(0.0), p9(0.0) {}
-            Event(lsst::afw::image::Image<float> const& im, ///< image containing event
+            Event(data_str const& ds) : data_str(ds), grade(UNKNOWN), sum(0.0), p9(0.0), flags(0), map(0) {}
+            /*
+             * Extract the 3x3 pixels around cen (in the image's parent coordinates).  Instantiated for
+             * boost::uint16_t, int, float and double, so raw integer ADUs can be read without first
+             * converting the image to float, and for the measurement framework;  if the image hasn't
+             * been bias subtracted pass the bias level in bias (it's subtracted pixel-by-pixel as we extract)
+             */
+            template<typename PixelT>
+            Event(lsst::afw::image::Image<PixelT> const& im, ///< image containing event
                   lsst::afw::geom::Point2I const& cen,      ///< central pixel
                   int framenum=-1,                          ///< frame ID of image
-                  int chipnum=-1                            ///< chip ID for image
+                  int chipnum=-1,                           ///< chip ID for image
+                  double bias=0.0                           ///< bias level to subtract from pixel values
                  );
 
             Grade grade;                  ///< Event's grade
             float sum;                    ///< Sum of counts in Event
             float p9;                     ///< Event's "P9" sum
+            int flags;                    ///< Event's Flags, set by classification (EDGE by extraction)
+            /*
+             * HistogramTable::classify() doesn't reclassify an Event that it's already classified with the
+             * same ClassificationKey.  If you change the data[] of a classified Event, call
+             * invalidateClassification()
+             */
+            int map;                      ///< the map of pixels above the split threshold (see grades.h)
+            ClassificationKey classifiedBy; ///< how grade, sum, p9, flags and map were calculated
+
+            void invalidateClassification() { classifiedBy = ClassificationKey(); }
         };
 
         std::vector<boost::shared_ptr<Event> > readEventFile(std::string const& fileName);
+        /*
+         * Write events to fileName in RV format (i.e. as data_strs), to be read by readEventFile or the rv tools
+         */
+        void writeEventFile(std::string const& fileName, std::vector<boost::shared_ptr<Event> > const& events);
     }
 }
 #endif
@@ -0,0 +1,38 @@
+#if !defined(LSST_RASMUSSEN_ASSEMBLE_H)
+#define LSST_RASMUSSEN_ASSEMBLE_H
+
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include "ndarray.h"
+#include "lsst/rasmussen/geometry.h"
+
+namespace lsst {
+    namespace afw {
+        namespace image {
+            template<typename T> class Image;
+        }
+    }
+    namespace rasmussen {
+        /*
+         * Assemble a CCD image from the amps in fileName (amp with channel c is in HDU 1 + c).
+         *
+         * Each amp is read, bias subtracted (if trim; either per row with the median of that row of the
+         * overclock, or with a clipped mean of the whole overclock), trimmed, flipped/rotated into the
+         * CCD's orientation and divided by its gain in one pass, straight into the CCD image.  The
+         * layout matches cameraGeom.makeCcd(fileName, trim=trim).getAllPixels(trim)
+         *
+         * The amps are read and processed by nThread threads (0: one per amp), each with its own
+         * cfitsio handle on a FitsSource.  If cfitsio wasn't built to be reentrant, one thread is used
+         */
+        boost::shared_ptr<lsst::afw::image::Image<float> >
+        assembleCcd(std::string const& fileName,
+                    std::vector<AmpGeometry> const& amps,
+                    ndarray::Array<double const,1,1> const& gains, // one per amp
+                    bool trim=true,
+                    bool perRow=true,
+                    int nThread=0
+                   );
+    }
+}
+#endif
@@ -0,0 +1,79 @@
+#if !defined(LSST_RASMUSSEN_COLUMNS_H)
+#define LSST_RASMUSSEN_COLUMNS_H
+#include "ndarray.h"
+#include "lsst/rasmussen/Event.h"
+
+namespace lsst {
+    namespace rasmussen {
+        /*
+         * A set of events stored by column (one array per field of data_str/Event) rather than
+         * as an array of structs, so that cuts and counts can run down a contiguous column
+         *
+         * The getXXX() methods return views of the first size() elements of each column; they
+         * remain valid (but stop tracking the EventColumns) if more events are added
+         *
+         * The grade, sum, p9 and flags columns are a cache of classifications made with
+         * getClassificationKey();  events that haven't been classified with that key have grade
+         * Event::UNKNOWN.  If you change the data of classified events, call invalidateClassification()
+         *
+         * The flags column also carries the EDGE flag set by EventExtractor (which classification keeps)
+         */
+        class EventColumns {
+        public:
+            explicit EventColumns(int capacity=0);
+
+            int size() const { return _size; }
+            int capacity() const { return _capacity; }
+            void reserve(int capacity);
+            void clear() { _size = 0; }
+
+            void push_back(data_str const& ev);
+            void push_back(Event const& ev);
+            void append(data_str const* evs, int n);
+            void append(std::vector<boost::shared_ptr<Event> > const& evs);
+
+            data_str getDataStr(int i) const;
+            Event getEvent(int i) const;
+
+            ndarray::Array<float, 2, 2> getData() const;  // (size, 9) pixel values
+            ndarray::Array<int, 1, 1> getFramenum() const;
+            ndarray::Array<int, 1, 1> getChipnum() const;
+            ndarray::Array<int, 1, 1> getX() const;
+            ndarray::Array<int, 1, 1> getY() const;
+            ndarray::Array<int, 1, 1> getMode() const;
+            ndarray::Array<int, 1, 1> getGrade() const;   // Event::Grade, set by classification
+            ndarray::Array<float, 1, 1> getSum() const;
+            ndarray::Array<float, 1, 1> getP9() const;
+            ndarray::Array<int, 1, 1> getFlags() const;   // Event::Flags
+
+            ClassificationKey const& getClassificationKey() const { return _classifiedBy; }
+            /*
+             * Prepare to cache classifications made with key;  if it isn't the key that we already
+             * have, all the cached classifications are discarded
+             */
+            void setClassificationKey(ClassificationKey const& key);
+            void invalidateClassification() { setClassificationKey(ClassificationKey()); }
+            bool isClassified(int i) const { return _grade[i] != Event::UNKNOWN; }
+            void setClassification(int i, Event const& ev); // ev must have been classified with our key
+        private:
+            int _size;
+            int _capacity;
+
+            ndarray::Array<float, 2, 2> _data;
+            ndarray::Array<int, 1, 1> _framenum;
+            ndarray::Array<int, 1, 1> _chipnum;
+            ndarray::Array<int, 1, 1> _x;
+            ndarray::Array<int, 1, 1> _y;
+            ndarray::Array<int, 1, 1> _mode;
+            ndarray::Array<int, 1, 1> _grade;
+            ndarray::Array<float, 1, 1> _sum;
+            ndarray::Array<float, 1, 1> _p9;
+            ndarray::Array<int, 1, 1> _flags;
+            ndarray::Array<int, 1, 1> _map;
+            ClassificationKey _classifiedBy;
+
+            void _grow(int n);
+        };
+    }
+}
+#endif
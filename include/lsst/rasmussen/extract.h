@@ -0,0 +1,55 @@
+#if !defined(LSST_RASMUSSEN_EXTRACT_H)
+#define LSST_RASMUSSEN_EXTRACT_H
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include "ndarray.h"
+#include "lsst/rasmussen/Event.h"
+
+namespace lsst {
+    namespace rasmussen {
+        /*
+         * Extract the 3x3 stamps around a list of peaks, as Event's constructor does for one peak
+         * at a time, but without throwing for peaks that are too close to the edge of the image;
+         * what happens to them is set by the EdgePolicy:
+         *   SKIP      Don't make an Event (as the constructor would throw)
+         *   CLAMP     Use the nearest pixel in the image for pixels off the edge
+         *   ZERO_PAD  Set the pixels off the edge to 0 (i.e. to the bias level)
+         *   FLAG      As ZERO_PAD, and set the Event's EDGE flag so that HistogramTable,
+         *             HistogramBank and EventFilter won't use it (EventColumns keeps the flag)
+         * Peaks that aren't in the image at all are always skipped.  The numbers of peaks that
+         * were near the edge, and that were skipped, are available after each call
+         */
+        class EventExtractor {
+        public:
+            enum EdgePolicy { SKIP, CLAMP, ZERO_PAD, FLAG };
+
+            explicit EventExtractor(EdgePolicy edgePolicy=SKIP) :
+                _edgePolicy(edgePolicy), _nEdge(0), _nSkipped(0) {}
+
+            EdgePolicy getEdgePolicy() const { return _edgePolicy; }
+            void setEdgePolicy(EdgePolicy edgePolicy) { _edgePolicy = edgePolicy; }
+            /*
+             * Return Events for the peaks at (x[i], y[i]) (in the image's parent coordinates), in order;
+             * if the image hasn't been bias subtracted pass the bias level in bias.  Instantiated for
+             * the same pixel types as Event's constructor
+             */
+            template<typename PixelT>
+            std::vector<boost::shared_ptr<Event> >
+            extractEvents(lsst::afw::image::Image<PixelT> const& im,
+                          ndarray::Array<int const, 1, 1> const& x,
+                          ndarray::Array<int const, 1, 1> const& y,
+                          int framenum=-1,
+                          int chipnum=-1,
+                          double bias=0.0
+                         );
+
+            int getNEdge() const { return _nEdge; }       // peaks within a pixel of the edge, last call
+            int getNSkipped() const { return _nSkipped; } // peaks that didn't become Events, last call
+        private:
+            EdgePolicy _edgePolicy;
+            int _nEdge;
+            int _nSkipped;
+        };
+    }
+}
+#endif
@@ -26,16 +26,36 @@
  * @file
  */
 
-#include "lsst/meas/algorithms/Measure.h"
-#include "lsst/meas/algorithms/CentroidControl.h"
+#include <limits>
+#include "lsst/meas/algorithms/Algorithm.h"
+#include "lsst/rasmussen/tables.h"
 
 namespace lsst {
 namespace rasmussen {
 
-class Fe55Control : public lsst::meas::algorithms::CentroidControl {
+/**
+ * Control for the "fe55" measurement algorithm, which extracts the 3x3 stamp centred on each
+ * source's (rounded) centroid and classifies it as an X-ray event, just as fe55.processImage does.
+ *
+ * The event's grade, sum, p9 and Event::Flags are written to fields fe55.grade, fe55.sum,
+ * fe55.p9 and fe55.evflags;  fe55.flags is set if the event couldn't be classified (it's too
+ * close to the edge of the image, or is SATURATED or OVERFLOWED)
+ */
+class Fe55Control : public lsst::meas::algorithms::AlgorithmControl {
 public:
-    Fe55Control(int dY_=1) : lsst::meas::algorithms::CentroidControl("centroid.silly"), dY(dY_) {}
-    LSST_CONTROL_FIELD(dY, int, "Number of pixels to offset the centroid in y");
+    Fe55Control() :
+        lsst::meas::algorithms::AlgorithmControl("fe55", 3.0),
+        split(10), calctype(HistogramTable::P_9), pixelType(HistogramTable::FLOAT),
+        resetStyle(HistogramTable::TNONE), resetCoeff(0.0),
+        saturation(std::numeric_limits<double>::infinity())
+    {}
+
+    LSST_CONTROL_FIELD(split, int, "Split threshold");
+    LSST_CONTROL_FIELD(calctype, int, "How to calculate the sum (a HistogramTable::calctype)");
+    LSST_CONTROL_FIELD(pixelType, int, "How to handle pixel values (a HistogramTable::pixeltype)");
+    LSST_CONTROL_FIELD(resetStyle, int, "Reset clock correction style (a HistogramTable::RESET_STYLES)");
+    LSST_CONTROL_FIELD(resetCoeff, double, "Reset clock correction coefficient");
+    LSST_CONTROL_FIELD(saturation, double, "Events with a pixel at or above this level are flagged");
 private:
     virtual PTR(lsst::meas::algorithms::AlgorithmControl) _clone() const {
         return boost::make_shared<Fe55Control>(*this);
@@ -0,0 +1,48 @@
+#if !defined(LSST_RASMUSSEN_FILTER_H)
+#define LSST_RASMUSSEN_FILTER_H
+#include "ndarray.h"
+#include "lsst/rasmussen/columns.h"
+#include "lsst/rasmussen/tables.h"
+
+namespace lsst {
+    namespace rasmussen {
+        /*
+         * Select events in the manner of rv_gflt, but with more cuts
+         *
+         * The cuts that only need the raw event (central pixel at or above the table's event threshold,
+         * x/y ROI, frame and chip) are applied first as passes down the relevant columns, and only the
+         * events that survive are classified;  then the grade, PHA (sum), and p9 cuts are applied, and
+         * SATURATED or OVERFLOWED events rejected, as HistogramTable::process_event does.
+         *
+         * All ranges are lo <= value < hi, as for rv_gflt's -p phlo phhi
+         */
+        class EventFilter {
+        public:
+            EventFilter();
+
+            void setGrades(int grades) { _grades = grades; } // bitmask of (1 << grade), as HistogramTable::setFilter
+            void setPhaRange(float lo, float hi) { _phaLo = lo; _phaHi = hi; }
+            void setP9Range(float lo, float hi) { _p9Lo = lo; _p9Hi = hi; } // needs a table with a P_* calctype
+            void setXRange(int lo, int hi) { _xLo = lo; _xHi = hi; }
+            void setYRange(int lo, int hi) { _yLo = lo; _yHi = hi; }
+            void setFrameRange(int lo, int hi) { _frameLo = lo; _frameHi = hi; }
+            void setChipRange(int lo, int hi) { _chipLo = lo; _chipHi = hi; }
+            /*
+             * Return the indices of the events that pass all the cuts, classifying them with table.
+             * The grade, sum, p9 and flags columns are set for every event that got as far as being classified;
+             * events that already have classifications made with table's ClassificationKey aren't classified
+             * again.  Threads may apply filters at the same time with the same table, but not to the same events
+             */
+            ndarray::Array<int, 1, 1> apply(EventColumns & events, HistogramTable const& table) const;
+        private:
+            int _grades;
+            float _phaLo, _phaHi;
+            float _p9Lo, _p9Hi;
+            int _xLo, _xHi;
+            int _yLo, _yHi;
+            int _frameLo, _frameHi;
+            int _chipLo, _chipHi;
+        };
+    }
+}
+#endif
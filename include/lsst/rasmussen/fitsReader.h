@@ -0,0 +1,130 @@
+#if !defined(LSST_RASMUSSEN_FITSREADER_H)
+#define LSST_RASMUSSEN_FITSREADER_H
+
+#include <list>
+#include <string>
+#include <utility>
+#include <vector>
+#include <pthread.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
+#if !defined(SWIG)
+#include "fitsio.h"
+#endif
+
+namespace lsst {
+    namespace daf {
+        namespace base {
+            class PropertyList;
+        }
+    }
+    namespace afw {
+        namespace image {
+            template<typename T> class Image;
+        }
+    }
+    namespace rasmussen {
+#if !defined(SWIG)
+        /*
+         * A FITS file that may be opened by many threads at once, each with its own cfitsio handle.
+         *
+         * The handles are all on a copy of the file in memory (the file's mapped, unless it's gzipped),
+         * as cfitsio shares the innards of handles that it opened on the same file by name.
+         *
+         * cfitsio decompresses a gzipped file into memory every time that it's opened, so we do it
+         * once, here.  A gzip stream can't be decompressed in parallel, but everything else (converting
+         * pixels, and decompressing the tiles of Rice (fpack) compressed HDUs) can
+         */
+        class FitsSource : boost::noncopyable {
+        public:
+            explicit FitsSource(std::string const& fileName);
+            ~FitsSource();
+
+            std::string const& getFileName() const { return _fileName; }
+            /*
+             * Return a new handle on the file;  close it with fits_close_file
+             */
+            fitsfile *open() const;
+        private:
+            std::string _fileName;
+            void *_buff;                // the (decompressed) file
+            size_t _buffSize;           // size of _buff
+            size_t _fileSize;           // number of bytes of _buff that are the file
+            bool _mapped;               // _buff is mmapped, rather than malloced
+            mutable std::list<std::pair<void *, size_t> > _handles; // (buffer, size) for each handle
+            mutable pthread_mutex_t _lock;                         // protects _handles
+        };
+#endif
+        /*
+         * An image HDU, as returned by FitsReader
+         */
+        class FitsHdu {
+        public:
+            FitsHdu(int hdu,
+                    boost::shared_ptr<lsst::daf::base::PropertyList> metadata,
+                    boost::shared_ptr<lsst::afw::image::Image<float> > imageF,
+                    boost::shared_ptr<lsst::afw::image::Image<boost::uint16_t> > imageU
+                   ) : _hdu(hdu), _metadata(metadata), _imageF(imageF), _imageU(imageU) {}
+
+            int getHdu() const { return _hdu; } // 1-indexed, as cfitsio and afw count them
+            boost::shared_ptr<lsst::daf::base::PropertyList> getMetadata() const { return _metadata; }
+            /*
+             * The pixels;  only the one of these that the FitsReader was asked for is set
+             */
+            boost::shared_ptr<lsst::afw::image::Image<float> > getImageF() const { return _imageF; }
+            boost::shared_ptr<lsst::afw::image::Image<boost::uint16_t> > getImageU() const { return _imageU; }
+        private:
+            int _hdu;
+            boost::shared_ptr<lsst::daf::base::PropertyList> _metadata;
+            boost::shared_ptr<lsst::afw::image::Image<float> > _imageF;
+            boost::shared_ptr<lsst::afw::image::Image<boost::uint16_t> > _imageU;
+        };
+        /*
+         * Read the image HDUs of a (possibly gzipped, or tile-compressed) multi-extension FITS file
+         * in order, using nThread threads to read (and decompress) the HDUs in parallel.
+         *
+         * An empty PDU is skipped, and reading stops at the first HDU that isn't a 2-d image (e.g. a
+         * binary table), as fe55.processImage always has.  At most nThread HDUs are read ahead of
+         * the caller, so memory is bounded however large the file.
+         *
+         * If nThread is 0 a thread per core is used;  if cfitsio isn't reentrant, or nThread < 0,
+         * the HDUs are read by next() itself
+         */
+        class FitsReader : boost::noncopyable {
+        public:
+            enum PixelType { FLOAT, USHORT };
+
+            explicit FitsReader(std::string const& fileName, PixelType pixelType=FLOAT, int nThread=0);
+            ~FitsReader();
+            /*
+             * The number of image HDUs that we'll return
+             */
+            int size() const { return _hdus.size(); }
+            /*
+             * Return the next HDU, or NULL when there aren't any more
+             */
+            boost::shared_ptr<FitsHdu> next();
+        private:
+            boost::shared_ptr<FitsHdu> read(fitsfile *fptr, int hdu) const;
+            static void *runWorker(void *arg);
+            void work();
+
+            boost::shared_ptr<FitsSource> _source;
+            PixelType _pixelType;
+            std::vector<int> _hdus;     // the image HDUs to read
+
+            std::vector<boost::shared_ptr<FitsHdu> > _results; // HDUs read, but not yet returned
+            std::vector<std::string> _errors;                  // why we failed to read each HDU
+            int _nextToRead;            // index into _hdus of the next HDU that a worker should read
+            int _nextToReturn;          // index into _hdus of the next HDU that next() will return
+            int _window;                // how many HDUs may be read ahead of _nextToReturn
+            bool _stop;                 // the workers should exit
+
+            std::vector<pthread_t> _threads;
+            pthread_mutex_t _lock;
+            pthread_cond_t _cond;
+        };
+    }
+}
+#endif
@@ -0,0 +1,39 @@
+#if !defined(LSST_RASMUSSEN_GEOMETRY_H)
+#define LSST_RASMUSSEN_GEOMETRY_H
+
+namespace lsst {
+    namespace daf {
+        namespace base {
+            class PropertySet;
+        }
+    }
+    namespace rasmussen {
+        /*
+         * The geometry of an amplifier, as cameraGeom.makeAmp needs it:  where the amp sits in the CCD,
+         * how it's oriented, and where its data and overclock are in the pixels read from disk.
+         *
+         * Boxes are given as their lower-left corner and size, in the amp's on-disk coordinates
+         */
+        struct AmpGeometry {
+            int channel;                // amplifier's channel number (CHANNEL)
+            int iCol, iRow;             // amp's position in the CCD, in units of amps
+            int rotate90;               // number of 90-degree rotations to bring the amp into the CCD's frame
+            bool flipLR;                // flip the amp left-right to bring it into the CCD's frame
+            int width, height;          // all the pixels read through the amp
+            int dataX0, dataY0, dataWidth, dataHeight; // the real pixels (DataSec)
+            int biasX0, biasY0, biasWidth, biasHeight; // the overclock (BiasSec)
+        };
+        /*
+         * Return the geometry of the amp described by a FITS header (CHANNEL, DATASEC, LTV1/2 and LTMi_j).
+         *
+         * The result is cached, keyed by the values of those keywords, so all the HDUs of a run with
+         * the same layout share one calculation.  The cache isn't protected by a lock
+         */
+        AmpGeometry const& getAmpGeometry(lsst::daf::base::PropertySet const& md);
+        /*
+         * Return the geometry of a channel of the standard 16-amp CCD, without a header
+         */
+        AmpGeometry getAmpGeometry(int channel);
+    }
+}
+#endif
@@ -0,0 +1,69 @@
+#if !defined(LSST_RASMUSSEN_GRADES_H)
+#define LSST_RASMUSSEN_GRADES_H
+/*
+ *  grades.h -- the Dec92 exclusive grade table, shared by the RV tools and HistogramTable
+ *
+ *  The table is indexed by the event's map, the bits set for the
+ *  neighbouring pixels that are above the split threshold:
+ *
+ *	0x20 0x40 0x80		pixels	6 7 8
+ *	0x08  --  0x10			3 4 5
+ *	0x01 0x02 0x04			0 1 2
+ *
+ *  Each entry gives the grade (0 -- 7), and the corner pixels that
+ *  should be added to the summed pha (only set for the L, Q and Other
+ *  grades), using the same bits as the map.  It was generated from the
+ *  sngle/splus/pvert/pleft/prght/pplus/elnsq lists and the extra/emask
+ *  tables that rv_ev2pcf's prep_hist() used to build at run time;  it's
+ *  plain const data, so it lives in the read-only segment and costs
+ *  nothing to set up.
+ *
+ *  This file is C as well as C++
+ */
+struct rv_grade_entry {
+	unsigned char	grade;		/* grade of this map */
+	unsigned char	extra;		/* corners to add to the pha, as map bits */
+};
+
+static const struct rv_grade_entry rv_grades[256] = {
+	{0,0x00}, {1,0x00}, {2,0x00}, {5,0x00}, {1,0x00}, {1,0x00}, {5,0x00}, {7,0x00},  /* 0x00 */
+	{3,0x00}, {5,0x00}, {6,0x01}, {6,0x01}, {3,0x00}, {5,0x00}, {7,0x00}, {7,0x00},  /* 0x08 */
+	{4,0x00}, {4,0x00}, {6,0x04}, {7,0x00}, {5,0x00}, {5,0x00}, {6,0x04}, {7,0x00},  /* 0x10 */
+	{7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00},  /* 0x18 */
+	{1,0x00}, {1,0x00}, {2,0x00}, {5,0x00}, {1,0x00}, {1,0x00}, {5,0x00}, {7,0x00},  /* 0x20 */
+	{5,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {5,0x00}, {7,0x00}, {7,0x00}, {7,0x00},  /* 0x28 */
+	{4,0x00}, {4,0x00}, {6,0x04}, {7,0x00}, {5,0x00}, {5,0x00}, {6,0x04}, {7,0x00},  /* 0x30 */
+	{7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00},  /* 0x38 */
+	{2,0x00}, {2,0x00}, {7,0x00}, {7,0x00}, {2,0x00}, {2,0x00}, {7,0x00}, {7,0x00},  /* 0x40 */
+	{6,0x20}, {7,0x00}, {7,0x00}, {7,0x00}, {6,0x20}, {7,0x00}, {7,0x00}, {7,0x00},  /* 0x48 */
+	{6,0x80}, {6,0x80}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00},  /* 0x50 */
+	{7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00},  /* 0x58 */
+	{5,0x00}, {5,0x00}, {7,0x00}, {7,0x00}, {5,0x00}, {5,0x00}, {7,0x00}, {7,0x00},  /* 0x60 */
+	{6,0x20}, {7,0x00}, {7,0x00}, {7,0x00}, {6,0x20}, {7,0x00}, {7,0x00}, {7,0x00},  /* 0x68 */
+	{7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00},  /* 0x70 */
+	{7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00},  /* 0x78 */
+	{1,0x00}, {1,0x00}, {2,0x00}, {5,0x00}, {1,0x00}, {1,0x00}, {5,0x00}, {7,0x00},  /* 0x80 */
+	{3,0x00}, {5,0x00}, {6,0x01}, {6,0x01}, {3,0x00}, {5,0x00}, {7,0x00}, {7,0x00},  /* 0x88 */
+	{5,0x00}, {5,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00},  /* 0x90 */
+	{7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00},  /* 0x98 */
+	{1,0x00}, {1,0x00}, {2,0x00}, {5,0x00}, {1,0x00}, {1,0x00}, {5,0x00}, {7,0x00},  /* 0xa0 */
+	{5,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {5,0x00}, {7,0x00}, {7,0x00}, {7,0x00},  /* 0xa8 */
+	{5,0x00}, {5,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00},  /* 0xb0 */
+	{7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00},  /* 0xb8 */
+	{5,0x00}, {5,0x00}, {7,0x00}, {7,0x00}, {5,0x00}, {5,0x00}, {7,0x00}, {7,0x00},  /* 0xc0 */
+	{7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00},  /* 0xc8 */
+	{6,0x80}, {6,0x80}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00},  /* 0xd0 */
+	{7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00},  /* 0xd8 */
+	{7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00},  /* 0xe0 */
+	{7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00},  /* 0xe8 */
+	{7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00},  /* 0xf0 */
+	{7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00}, {7,0x00},  /* 0xf8 */
+};
+
+/*
+ *  The corner pixels, and their bits in the map (and in rv_grade_entry.extra)
+ */
+static const int		rv_corner_pixel[4] = { 0,    2,    6,    8    };
+static const unsigned char	rv_corner_bit[4]   = { 0x01, 0x04, 0x20, 0x80 };
+
+#endif
@@ -0,0 +1,132 @@
+#if !defined(LSST_RASMUSSEN_INSTRUMENT_H)
+#define LSST_RASMUSSEN_INSTRUMENT_H
+#include <string>
+#include <boost/cstdint.hpp>
+
+namespace lsst {
+    namespace rasmussen {
+        /*
+         * Where the time goes, and why events are rejected.
+         *
+         * Each thread keeps its own counters (so counting doesn't need a lock or an atomic), which are
+         * summed when they're read; a thread's counters are folded into the process's totals when it
+         * exits.  Times are read from the cycle counter (rdtsc on x86, else clock_gettime) and converted
+         * to seconds with a rate that's measured the first time that it's needed.
+         *
+         * The per-event entry points (Event's constructor, HistogramTable::classify and accumulate)
+         * only count;  timing each event would cost more than some of them do.  The time is measured
+         * around batches (reading an HDU, medpictSearch, EventFilter::apply, HistogramBank::process),
+         * and the python drivers add the times of their own loops with addSeconds().
+         *
+         * Compiling with -DLSST_RASMUSSEN_NO_INSTRUMENTATION removes all the counting from the library;
+         * the class is still there (so that python code needn't care), but isEnabled() is false and
+         * everything reads as 0
+         */
+        class Instrumentation {
+        public:
+            enum Stage {
+                READ,                   // reading (and decompressing) HDUs or frames;  counts HDUs
+                ASSEMBLE,               // assembling amps into a CCD;  counts CCDs
+                DETECT,                 // looking for candidate events;  counts candidates
+                EXTRACT,                // making Events from images;  counts Events
+                CLASSIFY,               // classifying events (not counting cached classifications)
+                HISTOGRAM,              // filtering and histogramming classified events
+                NSTAGE
+            };
+            enum Reason {
+                EDGE,                   // too close to the edge of the image (skipped, or flagged EDGE)
+                BELOW_THRESHOLD,        // central pixel below the event threshold
+                ROI,                    // outside an EventFilter's x/y/frame/chip ranges
+                UNGRADED,               // grade is UNKNOWN
+                GRADE_FILTER,           // grade not accepted by the filter
+                SATURATED,              // SATURATED or OVERFLOWED
+                OUT_OF_BOUNDS,          // sum too large to histogram (HistogramTable's noobnd)
+                PHA_RANGE,              // outside an EventFilter's PHA or p9 range
+                NREASON
+            };
+
+            static bool isEnabled();
+
+            static double getSeconds(Stage stage);
+            static boost::int64_t getCalls(Stage stage);
+            static boost::int64_t getEvents(Stage stage);
+            static double getEventRate(Stage stage); // events/s (0 if no time has been recorded)
+            static boost::int64_t getRejected(Reason reason);
+
+            static std::string getStageName(Stage stage);
+            static std::string getReasonName(Reason reason);
+            /*
+             * Record time spent (and events handled) outside the library, e.g. in a python loop
+             */
+            static void addSeconds(Stage stage, double seconds, boost::int64_t nEvent=0);
+            static void addRejected(Reason reason, boost::int64_t n=1);
+            /*
+             * Start counting again from zero (other threads' counters aren't touched; what they had
+             * counted so far is remembered, and subtracted when they're read)
+             */
+            static void reset();
+            /*
+             * All the counters, as a JSON object
+             */
+            static std::string toJson();
+#if !defined(SWIG)
+            /*
+             * A thread's counters
+             */
+            struct Counters {
+                boost::uint64_t cycles[NSTAGE];
+                boost::uint64_t calls[NSTAGE];
+                boost::uint64_t events[NSTAGE];
+                boost::uint64_t rejected[NREASON];
+            };
+
+            static Counters *getCounters() {
+                return _counters ? _counters : _registerThread();
+            }
+            static boost::uint64_t readCycles();
+            /*
+             * Add the cycles between construction and destruction (plus any events) to a stage
+             */
+            class Timer {
+            public:
+                explicit Timer(Stage stage) : _stage(stage), _nEvent(0), _t0(readCycles()) {}
+                ~Timer() {
+                    Counters *c = getCounters();
+                    c->cycles[_stage] += readCycles() - _t0;
+                    ++c->calls[_stage];
+                    c->events[_stage] += _nEvent;
+                }
+                void addEvents(boost::int64_t n) { _nEvent += n; }
+            private:
+                Stage _stage;
+                boost::int64_t _nEvent;
+                boost::uint64_t _t0;
+            };
+        private:
+            static __thread Counters *_counters;
+            static Counters *_registerThread();
+            static void _makeKey();
+            static void _retireThread(void *counters);
+#endif
+        };
+    }
+}
+/*
+ * The hooks that the library uses;  they vanish with -DLSST_RASMUSSEN_NO_INSTRUMENTATION
+ */
+#if defined(LSST_RASMUSSEN_NO_INSTRUMENTATION)
+#   define LSST_RASMUSSEN_TIMER(VAR, STAGE)
+#   define LSST_RASMUSSEN_TIMER_EVENTS(VAR, N)
+#   define LSST_RASMUSSEN_COUNT(STAGE, N)
+#   define LSST_RASMUSSEN_REJECT(REASON, N)
+#else
+#   define LSST_RASMUSSEN_TIMER(VAR, STAGE) \
+    lsst::rasmussen::Instrumentation::Timer VAR(lsst::rasmussen::Instrumentation::STAGE)
+#   define LSST_RASMUSSEN_TIMER_EVENTS(VAR, N) VAR.addEvents(N)
+#   define LSST_RASMUSSEN_COUNT(STAGE, N) \
+    (lsst::rasmussen::Instrumentation::getCounters()->events[lsst::rasmussen::Instrumentation::STAGE] += (N))
+#   define LSST_RASMUSSEN_REJECT(REASON, N) \
+    (lsst::rasmussen::Instrumentation::getCounters()->rejected[lsst::rasmussen::Instrumentation::REASON] += (N))
+#endif
+
+#endif
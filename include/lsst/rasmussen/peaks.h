@@ -0,0 +1,59 @@
+#if !defined(LSST_RASMUSSEN_PEAKS_H)
+#define LSST_RASMUSSEN_PEAKS_H
+#include <vector>
+#include "ndarray.h"
+
+namespace lsst {
+    namespace afw {
+        namespace image {
+            template<typename T> class Image;
+        }
+    }
+    namespace rasmussen {
+        /*
+         * Find the peaks at or above a threshold in an image, without building the Footprints that
+         * afw::detection::FootprintSet would;  all we want from them is the peaks, to extract the 3x3
+         * events around them.
+         *
+         * A peak is a pixel at or above the threshold that's a maximum of its 8 neighbours (those that
+         * are in the image):  greater than the pixel to its left and the three in the row below, and at
+         * least equal to the others, as medpict's search has it, so a flat-topped maximum has one peak.
+         * As with FootprintSet, every peak is reported, so an 8-connected group of pixels above the
+         * threshold may have several peaks (and always has at least one).  FootprintSet may break ties
+         * between equal pixels differently.
+         *
+         * The peaks are returned in row order, in the image's parent coordinates
+         */
+        class PeakFinder {
+        public:
+            explicit PeakFinder(double threshold, bool findValues=false) :
+                _threshold(threshold), _findValues(findValues) {}
+
+            double getThreshold() const { return _threshold; }
+            void setThreshold(double threshold) { _threshold = threshold; }
+            bool getFindValues() const { return _findValues; }
+            void setFindValues(bool findValues) { _findValues = findValues; }
+            /*
+             * Find the peaks in im, returning how many there are.  Instantiated for the same pixel
+             * types as Event's constructor
+             */
+            template<typename PixelT>
+            int findPeaks(lsst::afw::image::Image<PixelT> const& im);
+
+            int size() const { return _x.size(); }
+            /*
+             * The peaks found by the last call to findPeaks;  the values are only set if findValues is true
+             */
+            ndarray::Array<int, 1, 1> getX() const;
+            ndarray::Array<int, 1, 1> getY() const;
+            ndarray::Array<float, 1, 1> getValues() const;
+        private:
+            double _threshold;
+            bool _findValues;
+            std::vector<int> _x;
+            std::vector<int> _y;
+            std::vector<float> _values;
+        };
+    }
+}
+#endif
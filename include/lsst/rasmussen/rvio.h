@@ -0,0 +1,335 @@
+#if !defined(LSST_RASMUSSEN_RVIO_H)
+#define LSST_RASMUSSEN_RVIO_H
+/*
+ *  rvio.h -- block I/O of RV event streams, for the rv_* pipe tools
+ *
+ *  A reader hands out blocks of events straight from its buffers;  by default it
+ *  has two, and a thread fills one from the input while the tool works on the
+ *  other.  A writer collects events into one large block and writes it with a
+ *  single write(2).  Where we can (linux), pipes are enlarged to hold a whole
+ *  block, so each block crosses a pipe in one go.
+ *
+ *  The block size (in events) defaults to RV_IO_NEVENT, and may be set with the
+ *  environment variable RV_IO_NEVENT;  set RV_IO_THREAD=0 to read synchronously.
+ *
+ *  vmsplice(2) isn't used: the pages it hands to a pipe must not be reused
+ *  until the reader has consumed them, and we've no way of knowing when that is
+ *  without giving up the double buffering.  As the tools all transform their
+ *  events there's nothing for splice(2) to pass through unchanged either.
+ *
+ *  This file is C as well as C++, and is all static inline functions so that the
+ *  bin/ programs (which are built one file at a time) can use it without warnings
+ *  about the functions they don't call.  Link with -lpthread
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "lsst/rasmussen/rv.h"
+
+#define RV_IO_NEVENT	(1 << 14)	/* default number of events per block */
+
+#if defined(__linux__) && !defined(F_SETPIPE_SZ)
+#define F_SETPIPE_SZ	1031		/* only declared with _GNU_SOURCE */
+#endif
+
+/*
+ *  Read up to nbyte bytes, stopping early only at EOF or on error
+ */
+static inline ssize_t
+rv_read_full(int fd, char *buf, size_t nbyte)
+{
+	size_t nread = 0;
+
+	while (nread < nbyte) {
+		ssize_t n = read(fd, buf + nread, nbyte - nread);
+		if (n == 0) break;
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			return -1;
+		}
+		nread += n;
+	}
+	return nread;
+}
+
+/*
+ *  Write all nbyte bytes
+ */
+static inline int
+rv_write_full(int fd, const char *buf, size_t nbyte)
+{
+	while (nbyte > 0) {
+		ssize_t n = write(fd, buf, nbyte);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			return -1;
+		}
+		buf += n;
+		nbyte -= n;
+	}
+	return 0;
+}
+
+/*
+ *  The number of events per block, from $RV_IO_NEVENT if set
+ */
+static inline size_t
+rv_io_nevent(void)
+{
+	const char *val = getenv("RV_IO_NEVENT");
+	long n = val ? atol(val) : 0;
+
+	return (n > 0) ? (size_t)n : RV_IO_NEVENT;
+}
+
+/*
+ *  If fd is a pipe, try to make it big enough to hold nbyte bytes
+ */
+static inline void
+rv_io_pipe_size(int fd, size_t nbyte)
+{
+#if defined(F_SETPIPE_SZ)
+	(void)fcntl(fd, F_SETPIPE_SZ, (int)nbyte);	/* fails harmlessly if fd isn't a pipe */
+#else
+	(void)fd; (void)nbyte;
+#endif
+}
+
+/************************************************************************/
+
+struct rv_reader {
+	int		fd;
+	size_t		nevent;		/* size of a block, in events */
+	struct data_str	*buf[2];
+	ssize_t		nbuf[2];	/* number of events in buf[i]; -1 while it's being filled */
+	int		cur;		/* the buffer that the caller has */
+	int		done;		/* the caller's had the last block */
+	int		err;		/* errno of a failed read */
+	int		threaded;
+	int		stop;		/* the caller wants the thread to exit */
+	pthread_t	thread;
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;
+};
+
+/*
+ *  Read a block of events into buf[i], returning the number read (a short block means EOF).
+ *  A trailing partial event is dropped, as fread does
+ */
+static inline ssize_t
+rv_reader_fill(struct rv_reader *r, int i, int *err)
+{
+	ssize_t n = rv_read_full(r->fd, (char *)r->buf[i], r->nevent*sizeof(struct data_str));
+
+	if (n < 0) {
+		*err = errno;
+		n = 0;
+	}
+	return n/sizeof(struct data_str);
+}
+
+/*
+ *  The read-ahead thread:  fill the buffers in turn, each as soon as the caller's given it back
+ */
+static inline void *
+rv_reader_main(void *arg)
+{
+	struct rv_reader *r = (struct rv_reader *)arg;
+	int i = 0, err = 0, stop;
+	ssize_t n;
+
+	do {
+		pthread_mutex_lock(&r->lock);
+		while (r->nbuf[i] >= 0 && !r->stop) pthread_cond_wait(&r->cond, &r->lock);
+		stop = r->stop;
+		pthread_mutex_unlock(&r->lock);
+		if (stop) break;
+
+		n = rv_reader_fill(r, i, &err);	/* we own buf[i] until we set nbuf[i] */
+
+		pthread_mutex_lock(&r->lock);
+		r->nbuf[i] = n;
+		if (err) r->err = err;
+		pthread_cond_broadcast(&r->cond);
+		pthread_mutex_unlock(&r->lock);
+		i = 1 - i;
+	} while (n == (ssize_t)r->nevent);
+
+	return NULL;
+}
+
+/*
+ *  Start reading events from fd.  Returns 0 on success
+ */
+static inline int
+rv_reader_open(struct rv_reader *r, int fd)
+{
+	const char *val = getenv("RV_IO_THREAD");
+
+	memset(r, '\0', sizeof(*r));
+	r->fd = fd;
+	r->nevent = rv_io_nevent();
+	r->buf[0] = (struct data_str *)malloc(r->nevent*sizeof(struct data_str));
+	r->buf[1] = (struct data_str *)malloc(r->nevent*sizeof(struct data_str));
+	if (!r->buf[0] || !r->buf[1]) return -1;
+	r->nbuf[0] = r->nbuf[1] = -1;
+	r->cur = -1;
+	rv_io_pipe_size(fd, r->nevent*sizeof(struct data_str));
+
+	r->threaded = !(val && atoi(val) == 0);
+	if (r->threaded) {
+		pthread_mutex_init(&r->lock, NULL);
+		pthread_cond_init(&r->cond, NULL);
+		if (pthread_create(&r->thread, NULL, rv_reader_main, r) != 0) {
+			pthread_mutex_destroy(&r->lock);
+			pthread_cond_destroy(&r->cond);
+			r->threaded = 0;
+		}
+	}
+	return 0;
+}
+
+/*
+ *  Return the next block of events in *evs, and the number of events in it (0 at EOF).
+ *  The events may be modified, and are valid until the next call
+ */
+static inline size_t
+rv_read_events(struct rv_reader *r, struct data_str **evs)
+{
+	ssize_t n;
+	int i;
+
+	if (r->done) return 0;
+
+	if (!r->threaded) {
+		n = rv_reader_fill(r, 0, &r->err);
+		*evs = r->buf[0];
+	} else {
+		pthread_mutex_lock(&r->lock);
+		if (r->cur >= 0) {		/* give the thread back the previous block */
+			r->nbuf[r->cur] = -1;
+			pthread_cond_broadcast(&r->cond);
+		}
+		i = (r->cur < 0) ? 0 : 1 - r->cur;
+		while (r->nbuf[i] < 0) pthread_cond_wait(&r->cond, &r->lock);
+		r->cur = i;
+		n = r->nbuf[i];
+		pthread_mutex_unlock(&r->lock);
+		*evs = r->buf[i];
+	}
+	if (n < (ssize_t)r->nevent) r->done = 1;
+
+	return n;
+}
+
+/*
+ *  Check whether a read failed:  rv_read_events returns 0 after an error just as it does at EOF,
+ *  so call this once it has.  Returns -1 (with errno set) if a read failed, else 0.
+ *
+ *  r->err was set before the last block was handed out (under the lock, if threaded), so we
+ *  needn't lock to read it
+ */
+static inline int
+rv_reader_error(const struct rv_reader *r)
+{
+	if (r->err) {
+		errno = r->err;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ *  Stop reading.  If the caller stopped before EOF, the read-ahead thread may be blocked
+ *  in read(2);  in that case we leave it (and its buffers) to die with the process
+ */
+static inline void
+rv_reader_close(struct rv_reader *r)
+{
+	if (r->threaded) {
+		pthread_mutex_lock(&r->lock);
+		r->stop = 1;
+		pthread_cond_broadcast(&r->cond);
+		pthread_mutex_unlock(&r->lock);
+		if (!r->done) {
+			pthread_detach(r->thread);
+			return;
+		}
+		pthread_join(r->thread, NULL);
+		pthread_mutex_destroy(&r->lock);
+		pthread_cond_destroy(&r->cond);
+	}
+	free(r->buf[0]);
+	free(r->buf[1]);
+}
+
+/************************************************************************/
+
+struct rv_writer {
+	int		fd;
+	size_t		nevent;		/* size of the block, in events */
+	size_t		n;		/* number of events waiting to be written */
+	struct data_str	*buf;
+	int		err;		/* errno of a failed write */
+};
+
+/*
+ *  Start writing events to fd.  Returns 0 on success
+ */
+static inline int
+rv_writer_open(struct rv_writer *w, int fd)
+{
+	memset(w, '\0', sizeof(*w));
+	w->fd = fd;
+	w->nevent = rv_io_nevent();
+	w->buf = (struct data_str *)malloc(w->nevent*sizeof(struct data_str));
+	if (!w->buf) return -1;
+	rv_io_pipe_size(fd, w->nevent*sizeof(struct data_str));
+
+	return 0;
+}
+
+static inline int
+rv_writer_flush(struct rv_writer *w)
+{
+	if (w->n > 0 && !w->err &&
+	    rv_write_full(w->fd, (const char *)w->buf, w->n*sizeof(struct data_str)) < 0) {
+		w->err = errno;
+	}
+	w->n = 0;
+
+	return w->err ? -1 : 0;
+}
+
+/*
+ *  Queue num events for writing
+ */
+static inline int
+rv_write_events(struct rv_writer *w, const struct data_str *evs, size_t num)
+{
+	while (num > 0) {
+		size_t n = w->nevent - w->n;
+		if (n > num) n = num;
+		memcpy(w->buf + w->n, evs, n*sizeof(struct data_str));
+		w->n += n;
+		evs += n;
+		num -= n;
+		if (w->n == w->nevent && rv_writer_flush(w) < 0) return -1;
+	}
+	return 0;
+}
+
+static inline int
+rv_writer_close(struct rv_writer *w)
+{
+	int ret = rv_writer_flush(w);
+
+	free(w->buf);
+	w->buf = NULL;
+	return ret;
+}
+
+#endif
@@ -0,0 +1,37 @@
+#if !defined(LSST_RASMUSSEN_SEARCH_H)
+#define LSST_RASMUSSEN_SEARCH_H
+#include <string>
+#include <vector>
+#include "lsst/rasmussen/columns.h"
+
+namespace lsst {
+    namespace rasmussen {
+        /*
+         * How to run medpict_lsst's burst-mode event search (medpict -b -e)
+         */
+        struct MedpictConfig {
+            // The frame formats that medpict knows about, named by the letter used with its -f option
+            enum Format { E2V_CCD250='c', LSST_STA='s', BNL_E2V='e', LBOX='l', HIREFS='h', ASTD='a', BERLIN='b' };
+
+            MedpictConfig() : format(LSST_STA), ocCorrection(false), evthresh(20), rebin(1), biasFile("") {}
+
+            Format format;              // -f: format of the frames (and thus their overclock regions)
+            bool ocCorrection;          // -c: correct each frame for its mean overclock level
+            int evthresh;               // -t: event threshold
+            int rebin;                  // -R: rebin the frames by this factor before searching
+            std::string biasFile;       // -B: bias frame to use rather than the median of the inputs
+        };
+        /*
+         * Search a set of frames for events exactly as medpict_lsst does in burst mode:  read all the
+         * frames, correct for the overclock, subtract the median (or supplied) bias, and look for local
+         * maxima above config.evthresh.
+         *
+         * The events are appended to events in the order that medpict writes them, with framenum set to
+         * the index of the file in fileNames.  Throws std::runtime_error if the frames can't be read
+         */
+        void medpictSearch(std::vector<std::string> const& fileNames,
+                           MedpictConfig const& config,
+                           EventColumns & events);
+    }
+}
+#endif
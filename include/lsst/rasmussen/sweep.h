@@ -0,0 +1,65 @@
+#if !defined(LSST_RASMUSSEN_SWEEP_H)
+#define LSST_RASMUSSEN_SWEEP_H
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include "lsst/rasmussen/columns.h"
+#include "lsst/rasmussen/tables.h"
+
+namespace lsst {
+    namespace rasmussen {
+        /*
+         * A bank of HistogramTables, one for each point of a grid of (event threshold, split threshold,
+         * calctype), filled from a single pass over a set of events.
+         *
+         * Only the split threshold and calctype affect an event's classification, so each event is
+         * classified once per (split, calctype) and the result shared by all the event thresholds;
+         * an event that's below all of the thresholds isn't classified at all
+         */
+        class HistogramBank {
+        public:
+            HistogramBank(std::vector<int> const& events, // all combinations of these values are used
+                          std::vector<int> const& splits,
+                          std::vector<HistogramTable::calctype> const& calctypes);
+
+            int size() const { return _tables.size(); }
+            /*
+             * Return the i'th table;  the grid is ordered with event threshold varying slowest
+             * and calctype fastest
+             */
+            boost::shared_ptr<HistogramTable> getTable(int i) const;
+            boost::shared_ptr<HistogramTable> getTable(int event, int split,
+                                                       HistogramTable::calctype calctype) const;
+            int getEventThreshold(int i) const;
+            int getSplitThreshold(int i) const;
+            HistogramTable::calctype getCalctype(int i) const;
+            /*
+             * Settings applied to every table, as HistogramTable's
+             */
+            void setFilter(int filter);
+            void setReset(HistogramTable::RESET_STYLES sty, double rst);
+            void setPixelType(HistogramTable::pixeltype pixelType);
+            void setSaturation(double saturation);
+            /*
+             * Add events to all the tables
+             */
+            void process(EventColumns const& events);
+            void process(std::vector<boost::shared_ptr<Event> > const& events);
+        private:
+            struct Point {
+                int event;
+                int split;
+                HistogramTable::calctype calctype;
+                int classifier;         // index into _classifiers
+            };
+
+            std::vector<Point> _grid;
+            std::vector<boost::shared_ptr<HistogramTable> > _tables;
+            std::vector<HistogramTable> _classifiers; // one per (split, calctype)
+            int _minEvent;                            // lowest event threshold in the grid
+            std::vector<Event> _scratch;              // an event classified by each classifier
+
+            void _process(data_str const& ds, int flags); // flags: the event's Event::Flags
+        };
+    }
+}
+#endif
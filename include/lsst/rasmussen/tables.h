@@ -16,25 +16,62 @@ public:
                     P_1357,
                     P_LIST,             // for the "total"
     };
+    enum pixeltype { SHORT,             // pixels are truncated to short, as the RV tools always have
+                     INT,               // pixels are handled as int; exact for integer ADUs
+                     FLOAT,             // pixels are handled as float
+    };
 
     HistogramTable(int event=0, int split=0,
                        RESET_STYLES sty=TNONE, double rst=0.0, const int filter=~0,
                        calctype do_what=HistogramTable::P_LIST);
     virtual ~HistogramTable() {}
     virtual bool process_event(lsst::rasmussen::Event *ev);
+    bool accumulate(lsst::rasmussen::Event const* ev);
 
     void dump_head(FILE *fd=stdout, const char *sfile=NULL, int total=-1);
     void dump_hist(FILE *fd=stdout, const char *sfile=NULL) const;
     void dump_table() const;
 
+    /*
+     * Classify ev, setting its grade, sum, p9, flags and map, and return the map.  If ev has already
+     * been classified with this table's ClassificationKey the results are reused.  The table isn't
+     * modified, so many threads may classify with the same table at once
+     */
     virtual int classify(lsst::rasmussen::Event *ev) const;
-    
+    lsst::rasmussen::ClassificationKey getClassificationKey() const;
+
     void setFilter(const int filter) { _filter = filter; }
     void setCalctype(const calctype do_what) { _do_what = do_what; }
     void setReset(const RESET_STYLES sty, double rst) { _sty = sty; _rst = rst; }
+    void setPixelType(const pixeltype pixelType) { _pixelType = pixelType; }
+    void setSaturation(const double saturation) { _saturation = saturation; }
+    int getEventThreshold() const { return _event; }
+    /*
+     * Add a batch of already-classified (and filtered) events to counts[] and ntotal, given their grades.
+     * Grades outside 0..NGRADE-1 (e.g. Event::UNKNOWN) are ignored
+     */
+    void countGrades(ndarray::Array<int const, 1, 1> const& grades);
+    /*
+     * Add the counts, histograms and bounds of other (e.g. filled by another process from other files)
+     * to ours, giving the same results as if this table had processed other's events itself.  The tables
+     * must have the same event and split thresholds
+     */
+    void merge(HistogramTable const& other);
 
-    int		nsngle,nsplus,npvert,npleft,nprght,npplus,
-		nelnsq,nother,ntotal,noobnd,nbevth;
+    enum { NGRADE = 8 };                // number of grades (0..7)
+    int		counts[NGRADE];         // number of events of each grade in the histograms
+    // Named accessors for counts[]
+    int nsngle() const { return counts[0]; }
+    int nsplus() const { return counts[1]; }
+    int npvert() const { return counts[2]; }
+    int npleft() const { return counts[3]; }
+    int nprght() const { return counts[4]; }
+    int npplus() const { return counts[5]; }
+    int nelnsq() const { return counts[6]; }
+    int nother() const { return counts[7]; }
+
+    int		ntotal,noobnd,nbevth;
+    int		nsatur;                 // number of events rejected as SATURATED or OVERFLOWED
     int		ev_min, xav, yav;
     int		min_adu, max_adu;
     int		min_2ct, max_2ct;
@@ -42,22 +79,19 @@ public:
 
     ndarray::Array<int, 2, 2> histo;
 protected:
-    enum { NMAP = 256 };
-    struct look_up {
-        look_up() : grade(lsst::rasmussen::Event::UNKNOWN), type(0), extr(0), hist() {}
-
-        lsst::rasmussen::Event::Grade grade;
-        int *type;
-        const int *extr;
-        ndarray::Array<int, 1, 1> hist;
-    } table[NMAP];
+    enum { NMAP = 256 };                // number of possible maps (see grades.h)
 
-    void applyResetClockCorrection(short phe[9]) const;
+    template<typename PixelT>
+    void applyResetClockCorrection(PixelT phe[9]) const;
+    template<typename PixelT>
+    int _classify(lsst::rasmussen::Event *ev) const;
 
     int _event;
     int _split;
     int _filter;
     calctype _do_what;
+    pixeltype _pixelType;
+    double _saturation;
 private:
     enum { NAMLEN = 512 };
 
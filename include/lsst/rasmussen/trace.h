@@ -0,0 +1,86 @@
+#if !defined(LSST_RASMUSSEN_TRACE_H)
+#define LSST_RASMUSSEN_TRACE_H
+#include <string>
+
+namespace lsst {
+    namespace rasmussen {
+        /*
+         * A recorder of timed spans (reading a file, an HDU or an amp, searching a frame, ...) that's
+         * written in the Chrome trace-event format, for viewing with chrome://tracing or Perfetto
+         * (ui.perfetto.dev).  Each thread is a row in the timeline, so you can see which amps were
+         * slow, and where threads waited for each other.
+         *
+         * Nothing is recorded until start() is called, and until then a span costs a test of a flag.
+         * Once started, a span costs two reads of the clock and appending a record to its thread's
+         * buffer (each thread has its own, so recording doesn't contend), so it's cheap enough to
+         * leave on for production runs;  the spans are per-HDU or per-frame, never per-event.  If a
+         * thread records more than getMaxSpans() spans the rest are dropped (and counted).
+         *
+         * Times are in microseconds since start().  Python code records its own spans with now() and
+         * addSpan() (see lsst.rasmussen.trace)
+         *
+         * Any thread may call any of these at any time;  the flags are read and written atomically, so
+         * recording can be started and stopped while worker threads are running
+         */
+        class Trace {
+        public:
+            static void start();        // start recording (clears anything already recorded)
+            static void stop();         // stop recording (but keep what's been recorded)
+            static bool isEnabled() { return __atomic_load_n(&_enabled, __ATOMIC_ACQUIRE); }
+            static void clear();
+
+            static double now();        // microseconds since start()
+            /*
+             * Record a span from t0 to t1 (as returned by now()) in the calling thread's timeline.
+             * args, if not empty, is a JSON object of extra information (e.g. {"hdu": 3})
+             */
+            static void addSpan(std::string const& name, std::string const& category,
+                                double t0, double t1, std::string const& args="");
+            /*
+             * Name the calling thread's row in the timeline
+             */
+            static void setThreadName(std::string const& name);
+
+            static int getNSpans();     // spans recorded
+            static int getNDropped();   // spans dropped because a thread's buffer was full
+            static int getMaxSpans() { return __atomic_load_n(&_maxSpans, __ATOMIC_RELAXED); }
+            static void setMaxSpans(int maxSpans) {
+                __atomic_store_n(&_maxSpans, maxSpans, __ATOMIC_RELAXED);
+            }
+            /*
+             * Write everything that's been recorded to fileName as a trace-event JSON file
+             */
+            static void write(std::string const& fileName);
+#if !defined(SWIG)
+            /*
+             * A span that lasts as long as the Span does
+             */
+            class Span {
+            public:
+                Span(char const *name, char const *category) :
+                    _name(name), _category(category), _t0(isEnabled() ? now() : -1) {}
+                ~Span() {
+                    if (_t0 >= 0) {
+                        addSpan(_name, _category, _t0, now(), _args.empty() ? _args : "{" + _args + "}");
+                    }
+                }
+                /*
+                 * Add information to the span; a no-op unless we're recording
+                 */
+                void addArg(char const *key, std::string const& value);
+                void addArg(char const *key, int value);
+            private:
+                char const *_name;
+                char const *_category;
+                double _t0;
+                std::string _args;
+            };
+#endif
+        private:
+            static bool _enabled;
+            static int _maxSpans;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,159 @@
+#
+# LSST Data Management System
+# Copyright 2008, 2009, 2010 LSST Corporation.
+#
+# This product includes software developed by the
+# LSST Project (http://www.lsstcorp.org/).
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the LSST License Statement and
+# the GNU General Public License along with this program.  If not,
+# see <http://www.lsstcorp.org/LegalNotices/>.
+#
+
+"""
+An on-disk cache of the events found in a file
+
+The events (3x3 stamps, in RV format) that fe55.processImage extracts from a file are saved in a
+directory .fe55cache next to the file (or in a directory of your choice), keyed by:
+   - the SHA-1 of the file's contents
+   - the search threshold
+   - how the bias was estimated
+   - the amp geometry (assembled or per-amp, and the geometry that cameraGeom.makeAmp imposes;
+     the geometry read from the headers is covered by the file's hash)
+so changing any of them misses the cache.  The serial numbers of the file's amps are saved too,
+as not every amp need have any events.  Hashing a large file is itself slow, so the hashes are
+remembered (in the cache directory's "index") along with each file's size and modification time.
+"""
+
+import hashlib
+import os
+import sys
+
+import lsst.pex.exceptions
+import lsst.rasmussen as ras
+import lsst.rasmussen.cameraGeom as cameraGeom
+
+CACHE_VERSION = 2                       # bump if the cached events change meaning
+
+class EventCache(object):
+    def __init__(self, cacheDir=None):
+        """An EventCache in cacheDir; if None, in a .fe55cache directory next to each file"""
+        self.cacheDir = cacheDir
+        self._indices = {}              # hashes of files, per cache directory
+        self._dirty = set()             # cache directories whose indices need writing
+
+    def _getCacheDir(self, fileName):
+        if self.cacheDir:
+            return self.cacheDir
+        return os.path.join(os.path.dirname(os.path.abspath(fileName)), ".fe55cache")
+
+    def _readIndex(self, cacheDir):
+        if cacheDir not in self._indices:
+            index = {}
+            try:
+                with open(os.path.join(cacheDir, "index")) as fd:
+                    for line in fd:
+                        fields = line.rstrip("\n").rsplit(" ", 3) # the file name may contain spaces
+                        if len(fields) == 4:
+                            index[fields[0]] = (int(fields[1]), float(fields[2]), fields[3])
+            except IOError:
+                pass
+            self._indices[cacheDir] = index
+
+        return self._indices[cacheDir]
+
+    def _writeIndex(self, cacheDir):
+        tmpFile = os.path.join(cacheDir, "index.%d" % os.getpid())
+        with open(tmpFile, "w") as fd:
+            for name, (size, mtime, sha1) in sorted(self._readIndex(cacheDir).items()):
+                print >> fd, name, size, repr(mtime), sha1
+        os.rename(tmpFile, os.path.join(cacheDir, "index"))
+        self._dirty.discard(cacheDir)
+
+    def fileHash(self, fileName):
+        """Return the SHA-1 of fileName's contents, reusing the hash from the index if the file's size
+        and modification time haven't changed"""
+        cacheDir = self._getCacheDir(fileName)
+        index = self._readIndex(cacheDir)
+        name = os.path.abspath(fileName)
+        st = os.stat(fileName)
+
+        if name in index and index[name][:2] == (st.st_size, st.st_mtime):
+            return index[name][2]
+
+        sha1 = hashlib.sha1()
+        with open(fileName, "rb") as fd:
+            while True:
+                buff = fd.read(1 << 20)
+                if not buff:
+                    break
+                sha1.update(buff)
+        index[name] = (st.st_size, st.st_mtime, sha1.hexdigest())
+        self._dirty.add(cacheDir)
+
+        return index[name][2]
+
+    def getKey(self, fileName, searchThresh, biasMethod, assembleCcd, peaksOnly=False):
+        """Return the key for the events found in fileName with these settings"""
+        if assembleCcd:
+            geometry = "assembled,perRow"
+        else:
+            amp = cameraGeom.makeAmp(None, 1)
+            geometry = "amp,%s,%s" % (amp.getDiskDataSec(), amp.getDiskBiasSec())
+
+        key = "%s %s %s %s %s" % (CACHE_VERSION, self.fileHash(fileName), searchThresh, biasMethod, geometry)
+        if peaksOnly:                   # found by PeakFinder rather than FootprintSet
+            key += " peaksOnly"
+        return hashlib.sha1(key).hexdigest()
+
+    def _getCacheFile(self, fileName, key):
+        return os.path.join(self._getCacheDir(fileName), "%s.%s.ev" % (os.path.basename(fileName), key))
+
+    def load(self, fileName, key):
+        """Return the cached (events, ampIds) for fileName, or None if there aren't any"""
+        cacheFile = self._getCacheFile(fileName, key)
+        if not os.path.exists(cacheFile):
+            return None
+        try:
+            with open(cacheFile + ".amps") as fd:
+                ampIds = set(int(_) for _ in fd.read().split())
+        except (IOError, ValueError):
+            return None
+
+        cacheDir = self._getCacheDir(fileName)
+        if cacheDir in self._dirty:     # e.g. the file was touched, but its contents are unchanged
+            try:
+                self._writeIndex(cacheDir)
+            except (OSError, IOError):
+                pass
+
+        return list(ras.readEventFile(cacheFile)), ampIds
+
+    def save(self, fileName, key, events, ampIds):
+        """Save the events found in fileName, and the serial numbers of its amps.  Failing to save isn't
+        an error (the directory may be read-only)"""
+        cacheDir = self._getCacheDir(fileName)
+        cacheFile = self._getCacheFile(fileName, key)
+        try:
+            if not os.path.isdir(cacheDir):
+                os.makedirs(cacheDir)
+
+            with open(cacheFile + ".amps", "w") as fd: # written first, as the events file marks an entry
+                print >> fd, " ".join(str(_) for _ in sorted(ampIds))
+
+            tmpFile = "%s.%d" % (cacheFile, os.getpid())
+            ras.writeEventFile(tmpFile, events)
+            os.rename(tmpFile, cacheFile) # so an interrupted write isn't mistaken for a complete one
+            self._writeIndex(cacheDir)
+        except (OSError, IOError, lsst.pex.exceptions.LsstCppException), e:
+            print >> sys.stderr, "Unable to cache events for %s: %s" % (fileName, e)
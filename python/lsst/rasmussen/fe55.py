@@ -29,6 +29,7 @@ Process Fe55 data
 import os
 import os.path
 import sys
+import time
 import numpy as np
 import lsst.daf.base as dafBase
 import lsst.pex.exceptions
@@ -41,6 +42,7 @@ import lsst.afw.display.ds9 as ds9
 
 import lsst.rasmussen as ras
 import lsst.rasmussen.cameraGeom as cameraGeom
+import lsst.rasmussen.trace as trace
 
 import numpy
 
@@ -75,68 +77,49 @@ def processImage(thresh, fileNames, grades=range(8), searchThresh=None, split=No
                  outputHistFile=None, outputEventsFile=None, assembleCcd=False, plotByAmp=False,
                  plot=True, subplots=False, xlim=[None, 650], ylim=[None, None],
                  displayRejects=False, displayUnknown=False, displayGrades=True, display=False, 
-                 emulateMedpict=None    # not used
+                 emulateMedpict=None,   # not used
+                 integerPixels=False,
+                 sweepThresholds=None, sweepSplits=None, sweepCalcTypes=None,
+                 eventCache=None, readThreads=0, peaksOnly=False,
                  ):
+    """Find and histogram Fe55 events
+
+    If integerPixels is True the raw ADUs are read as an ImageU, the bias is subtracted as the events are
+    extracted (rather than from the whole image), and the events are classified using int arithmetic.
+    This is ignored if assembleCcd is True, as the assembled image is gain-corrected.
+
+    If any of sweepThresholds, sweepSplits, or sweepCalcTypes is set, the events are histogrammed for every
+    combination of those values (defaulting to thresh, split, and calcType) in a single pass, and the
+    HistogramBank is returned; see sweep()
+
+    The HDUs of each file are read and decompressed (gzip or Rice tile compression) by readThreads
+    threads (0: one per core) while we search the ones already read; see rasmussen.FitsReader
+
+    If eventCache (an eventCache.EventCache) is provided, the events found in each file are saved in it,
+    and files whose events are already there aren't read or searched.  The cache isn't used if display
+    is True, as we need the images
+
+    If peaksOnly is True the peaks are found by rasmussen.PeakFinder rather than by building an
+    afwDetect.FootprintSet, whose Footprints we'd only throw away.  This is ignored if display is True,
+    as we need the Footprints to show the detections
+    """
 
     if searchThresh is None:
         searchThresh = thresh
 
+    if display:
+        eventCache = None
+
     nImage = 0                          # number of images we've processed
     events = []
     ampIds = set()
     for frameNum, fileName in enumerate(fileNames):
-        # Read file
-        hdu = 0                         # one-less than the next HDU
-        while True:                     # while there are valid HDUs
-            hdu += 1
-
-            if assembleCcd:
-                if hdu > 1:
-                    break
-
-                ccd, image = cameraGeom.assembleCcd(fileName, trim=True, perRow=True)
-                dataSec = image
-                ampIds = set(_.getId().getSerial() for _ in ccd)
-            else:
-                ccd = None              # we don't have an assembled Ccd
-                md = dafBase.PropertyList()
-                try:
-                    image = afwImage.ImageF(fileName, hdu, md)
-                except lsst.pex.exceptions.LsstCppException:
-                    if hdu == 1:            # an empty PDU
-                        continue
-                    break
-
-                # Get the image's camera geometry (e.g. where is the datasec?)
-                amp = cameraGeom.makeAmp(md)
-                ampIds.add(amp.getId().getSerial())
-                
-                # Subtract the bias, estimated as the median of the biassec
-                bias = image.Factory(image, amp.getDiskBiasSec())
-                image -= afwMath.makeStatistics(bias, afwMath.MEDIAN).getValue()
-                # Search the datasec for Fe55 events
-                dataSec = image.Factory(image, amp.getDiskDataSec())
-
-            nImage += 1
-            fs = afwDetect.FootprintSet(dataSec, afwDetect.Threshold(searchThresh))
-
-            if display:
-                mi = afwImage.makeMaskedImage(image)
-                afwDetect.setMaskFromFootprintList(mi.getMask(), fs.getFootprints(), 0x4)
-                ds9.mtv(mi, title="bkgd subtracted", frame=0)
-                del mi
-
-            # Convert all the peaks within the detections to Events
-            for foot in fs.getFootprints():
-                for i, peak in enumerate(foot.getPeaks()):
-                    peakPos = afwGeom.PointI(peak.getIx(), peak.getIy())
-                    if ccd:
-                        amp = ccd.findAmp(peakPos, True)
-                        
-                    try:
-                        events.append(ras.Event(image, peakPos, frameNum, amp.getId().getSerial()))
-                    except lsst.pex.exceptions.LsstCppException, e:
-                        pass
+        fileEvents, fileAmpIds, nFileImage = findEvents(frameNum, fileName, searchThresh, assembleCcd,
+                                                        integerPixels, readThreads, eventCache, display,
+                                                        peaksOnly)
+        events += fileEvents
+        ampIds |= fileAmpIds
+        nImage += nFileImage
     #
     # Prepare to go through all our events, building our histograms
     #
@@ -145,22 +128,23 @@ def processImage(thresh, fileNames, grades=range(8), searchThresh=None, split=No
 
     filt = sum([1 << g for g in grades])
 
+    if sweepThresholds or sweepSplits or sweepCalcTypes:
+        return sweep(events, sweepThresholds or [thresh], sweepSplits or [split], sweepCalcTypes or [calcType],
+                     filt, integerPixels=(integerPixels and not assembleCcd), outputHistFile=outputHistFile)
+
     tables = {}
     if plotByAmp:
         for aid in ampIds:
-            tables[aid] = ras.HistogramTable(thresh, split)
+            tables[aid] = makeHistogramTable(thresh, split, filt, calcType, integerPixels and not assembleCcd)
     else:
-        table = ras.HistogramTable(thresh, split)
+        table = makeHistogramTable(thresh, split, filt, calcType, integerPixels and not assembleCcd)
         for aid in ampIds:
             tables[aid] = table
-
-    for table in tables.values():
-        table.setFilter(filt)
-        table.setCalctype(calcType)
-        table.setReset(ras.HistogramTable.T1, 0.0)
-    del table
+        del table
 
     # Process the events
+    t0 = time.time()
+    tHistogram = trace.now()
     table0 = tables.values()[0]
     if plotByAmp:
         status = len(events)*[None]
@@ -168,6 +152,8 @@ def processImage(thresh, fileNames, grades=range(8), searchThresh=None, split=No
             status[i] = tables[ev.chipnum].process_event(ev)
     else:
         status = [table0.process_event(ev) for ev in events]
+    ras.Instrumentation.addSeconds(ras.Instrumentation.HISTOGRAM, time.time() - t0)
+    trace.addSpan("histogram", "events", tHistogram, nevent=len(events))
     print "Passed %5d events" % (sum(status))
     #
     # Estimate gain by looking for the peaks in the histograms (n.b. remember
@@ -184,10 +170,7 @@ def processImage(thresh, fileNames, grades=range(8), searchThresh=None, split=No
     # Done.  Output...
     #
     if outputEventsFile:
-        with open(outputEventsFile, "w") as fd:
-            for stat, ev in zip(status, events):
-                if stat:
-                    print >> fd, "%d %d %d %d %g %d" % (ev.x, ev.y, ev.grade, ev.sum, ev[4], ev.p9)
+        writeEvents(outputEventsFile, [ev for stat, ev in zip(status, events) if stat])
 
     if outputHistFile:
         with open(outputHistFile, "w") as fd:
@@ -223,6 +206,268 @@ def processImage(thresh, fileNames, grades=range(8), searchThresh=None, split=No
                   (thresh, split, os.path.basename(fileName), sum(status)),
                   xlim=xlim, ylim=ylim, subplots=subplots)
 
+def findEvents(frameNum, fileName, searchThresh, assembleCcd=False, integerPixels=False, readThreads=0,
+               eventCache=None, display=False, peaksOnly=False):
+    """Find the Fe55 events in fileName (the frameNum'th file), returning (events, ampIds, nImage)
+
+    ampIds is the set of the serial numbers of the amps that we saw, and nImage the number of images
+    searched (0 if the events came from eventCache).  The other arguments are as for processImage
+    """
+    nImage = 0
+    extractor = ras.EventExtractor(ras.EventExtractor.SKIP)
+    peakFinder = ras.PeakFinder(searchThresh) if peaksOnly and not display else None
+    ampIds = set()
+    tFile = trace.now()
+    if eventCache:
+        if assembleCcd:
+            biasMethod = "perRowMedian"
+        else:
+            biasMethod = "medianInt" if integerPixels else "median"
+        cacheKey = eventCache.getKey(fileName, searchThresh, biasMethod, assembleCcd, peakFinder is not None)
+
+        cached = eventCache.load(fileName, cacheKey)
+        if cached is not None:
+            fileEvents, ampIds = cached
+            for ev in fileEvents:
+                ev.framenum = frameNum
+            trace.addSpan("cached file", "file", tFile, file=fileName, nevent=len(fileEvents))
+            return fileEvents, ampIds, nImage
+
+    fileEvents = []
+    # Read file
+    if not assembleCcd:                 # the HDUs are read (and decompressed) in parallel, in C++
+        reader = ras.FitsReader(fileName,
+                                ras.FitsReader.USHORT if integerPixels else ras.FitsReader.FLOAT, readThreads)
+    while True:                         # while there are valid HDUs
+        if assembleCcd:
+            if nImage > 0:
+                break
+
+            spanArgs = dict(file=fileName)
+            with trace.span("assembleCcd", "file", **spanArgs):
+                ccd, image = cameraGeom.assembleCcd(fileName, trim=True, perRow=True)
+            dataSec = image
+            ampIds = set(_.getId().getSerial() for _ in ccd)
+            biasLevel = 0.0             # the assembled image is already bias subtracted
+        else:
+            ccd = None                  # we don't have an assembled Ccd
+            tWait = trace.now()
+            fitsHdu = reader.next()
+            if fitsHdu is None:             # no more image HDUs
+                break
+            # label the spans with the HDU as cfitsio numbers them, as the C++ "read HDU" spans are
+            spanArgs = dict(file=fileName, hdu=fitsHdu.getHdu())
+            trace.addSpan("wait for HDU", "hdu", tWait, **spanArgs)
+            md = fitsHdu.getMetadata()
+            image = fitsHdu.getImageU() if integerPixels else fitsHdu.getImageF()
+
+            # Get the image's camera geometry (e.g. where is the datasec?)
+            amp = cameraGeom.makeAmp(md)
+            ampIds.add(amp.getId().getSerial())
+            
+            # Estimate the bias as the median of the biassec
+            bias = image.Factory(image, amp.getDiskBiasSec())
+            with trace.span("bias", "amp", **spanArgs):
+                biasLevel = afwMath.makeStatistics(bias, afwMath.MEDIAN).getValue()
+            if integerPixels:
+                biasLevel = int(biasLevel + 0.5) # keep the events' pixel values integral
+            else:
+                image -= biasLevel
+                biasLevel = 0.0
+            # Search the datasec for Fe55 events
+            dataSec = image.Factory(image, amp.getDiskDataSec())
+
+        nImage += 1
+        if peakFinder:                  # the PeakFinder does its own Instrumentation
+            with trace.span("detect", "amp", **spanArgs):
+                peakFinder.setThreshold(searchThresh + biasLevel)
+                peakFinder.findPeaks(dataSec)
+            x, y = peakFinder.getX(), peakFinder.getY()
+        else:
+            t0 = time.time()
+            with trace.span("detect", "amp", **spanArgs):
+                fs = afwDetect.FootprintSet(dataSec, afwDetect.Threshold(searchThresh + biasLevel))
+            tDetect = time.time() - t0
+
+            if display:
+                mi = afwImage.makeMaskedImage(image)
+                afwDetect.setMaskFromFootprintList(mi.getMask(), fs.getFootprints(), 0x4)
+                ds9.mtv(mi, title="bkgd subtracted", frame=0)
+                del mi
+
+            peaks = [peak for foot in fs.getFootprints() for peak in foot.getPeaks()]
+            x = numpy.array([peak.getIx() for peak in peaks], dtype=numpy.int32)
+            y = numpy.array([peak.getIy() for peak in peaks], dtype=numpy.int32)
+            ras.Instrumentation.addSeconds(ras.Instrumentation.DETECT, tDetect, len(x))
+
+        # Convert all the peaks to Events, skipping those too close to the edge
+        t0 = time.time()
+        tExtract = trace.now()
+        newEvents = extractor.extractEvents(image, x, y, frameNum, -1 if ccd else amp.getId().getSerial(),
+                                            biasLevel)
+        if ccd:
+            for ev in newEvents:
+                ev.chipnum = ccd.findAmp(afwGeom.PointI(ev.x, ev.y), True).getId().getSerial()
+        fileEvents += newEvents
+        ras.Instrumentation.addSeconds(ras.Instrumentation.EXTRACT, time.time() - t0)
+        trace.addSpan("extract", "amp", tExtract, **spanArgs)
+
+    if eventCache:
+        eventCache.save(fileName, cacheKey, fileEvents, ampIds)
+    trace.addSpan("file", "file", tFile, file=fileName, nevent=len(fileEvents))
+
+    return fileEvents, ampIds, nImage
+
+def makeHistogramTable(thresh, split, filt=~0, calcType=ras.HistogramTable.P_9, integerPixels=False):
+    """Return a HistogramTable set up as processImage uses it"""
+    table = ras.HistogramTable(thresh, split)
+    table.setFilter(filt)
+    table.setCalctype(calcType)
+    table.setReset(ras.HistogramTable.T1, 0.0)
+    if integerPixels:
+        table.setPixelType(ras.HistogramTable.INT)
+
+    return table
+
+def processImageSharded(nProcess, thresh, fileNames, grades=range(8), searchThresh=None, split=None,
+                        calcType=ras.HistogramTable.P_9, outputHistFile=None, assembleCcd=False,
+                        integerPixels=False, eventCache=None, readThreads=0, peaksOnly=False):
+    """Find and histogram Fe55 events as processImage does, but with the files shared between nProcess
+    worker processes (0: one per core), returning the HistogramTable
+
+    The files are put on a queue that the workers take them from one at a time, so a worker that's
+    been given quick files takes more of them.  Each worker histograms the events that it finds into
+    its own HistogramTable, and sends its counts and histograms back when the queue's empty; we merge
+    them, giving the same table (and outputHistFile) as processImage would have.
+
+    Only the histogram is produced;  use processImage if you want the events, plots, or a sweep.
+    Each worker reads each file's HDUs with readThreads threads (0: share the cores between the workers).
+    The workers' Instrumentation counters and Trace spans aren't sent back
+    """
+    import multiprocessing
+    import Queue
+
+    if nProcess <= 0:
+        nProcess = multiprocessing.cpu_count()
+    if readThreads == 0:
+        readThreads = max(1, multiprocessing.cpu_count()//nProcess)
+    if searchThresh is None:
+        searchThresh = thresh
+    if split is None:
+        split = int(0.33*thresh)
+
+    filt = sum([1 << g for g in grades])
+    tableArgs = (thresh, split, filt, calcType, integerPixels and not assembleCcd)
+    findArgs = (searchThresh, assembleCcd, integerPixels, readThreads, eventCache, False, peaksOnly)
+
+    tasks = multiprocessing.Queue()
+    for frameNum, fileName in enumerate(fileNames):
+        tasks.put((frameNum, fileName))
+    results = multiprocessing.Queue()
+    workers = [multiprocessing.Process(target=_shardWorker, args=(tasks, results, tableArgs, findArgs))
+               for i in range(nProcess)]
+    for w in workers:
+        tasks.put(None)                 # tell a worker that there are no more files
+        w.start()
+
+    table = makeHistogramTable(*tableArgs)
+    shard = makeHistogramTable(*tableArgs)
+    errors = []
+    nResult = 0
+    while nResult < nProcess:
+        try:
+            status, result = results.get(True, 10)
+        except Queue.Empty:
+            if [w for w in workers if w.is_alive()] or not results.empty():
+                continue
+            errors.append("%d workers exited without sending their histograms" % (nProcess - nResult))
+            break
+
+        nResult += 1
+        if status == "ok":
+            shard.setState(result)
+            table.merge(shard)
+        else:
+            errors.append(result)
+    for w in workers:
+        w.join()
+
+    if errors:
+        raise RuntimeError("%d of %d workers failed:\n%s" % (len(errors), nProcess, "\n".join(errors)))
+
+    print "Passed %5d events" % (table.ntotal)
+
+    if outputHistFile:
+        with open(outputHistFile, "w") as fd:
+            table.dump_head(fd, "unknown", table.ntotal)
+            table.dump_hist(fd)
+
+    return table
+
+def _shardWorker(tasks, results, tableArgs, findArgs):
+    """Histogram the events in the files on the tasks queue until we see None, then put our table's
+    state on the results queue (or the reason why we failed)"""
+    try:
+        table = makeHistogramTable(*tableArgs)
+        while True:
+            task = tasks.get()
+            if task is None:
+                break
+            frameNum, fileName = task
+            events = findEvents(frameNum, fileName, *findArgs)[0]
+            for ev in events:
+                table.process_event(ev)
+
+        results.put(("ok", table.getState()))
+    except Exception:
+        import traceback
+        results.put(("error", "".join(traceback.format_exc())))
+
+def writeEvents(fileName, events):
+    """Write classified events to fileName, one per line:  x y grade sum data[4] p9
+
+    The events are copied into an EventColumns, and the columns written through numpy views of
+    its arrays, rather than by reading the events' fields one by one
+    """
+    columns = ras.EventColumns(len(events))
+    columns.append(events)
+
+    table = numpy.column_stack([columns.getX(), columns.getY(), columns.getGrade(), columns.getSum(),
+                                columns.getData()[:, 4], columns.getP9()])
+    with open(fileName, "w") as fd:
+        numpy.savetxt(fd, table, fmt="%d %d %d %d %g %d")
+
+def sweep(events, thresholds, splits, calcTypes, filt=~0, integerPixels=False, outputHistFile=None):
+    """Histogram events for every combination of thresholds, splits, and calcTypes in one pass, returning
+    the HistogramBank
+
+    Each event is classified once per (split, calcType), not once per table.  If outputHistFile is
+    provided, each table is written to outputHistFile-E<threshold>-S<split>-<calcType>
+    """
+    calcTypeNames = dict([(getattr(ras.HistogramTable, _), _)
+                          for _ in dir(ras.HistogramTable) if _.startswith("P_")])
+
+    bank = ras.HistogramBank(thresholds, splits, calcTypes)
+    bank.setFilter(filt)
+    bank.setReset(ras.HistogramTable.T1, 0.0)
+    if integerPixels:
+        bank.setPixelType(ras.HistogramTable.INT)
+
+    bank.process(events)
+
+    print "%-6s %-6s %-8s %8s" % ("Event", "Split", "CalcType", "Passed")
+    for i in range(bank.size()):
+        table = bank.getTable(i)
+        threshold, split, calcType = bank.getEventThreshold(i), bank.getSplitThreshold(i), bank.getCalctype(i)
+        print "%-6d %-6d %-8s %8d" % (threshold, split, calcTypeNames[calcType], table.ntotal)
+
+        if outputHistFile:
+            with open("%s-E%d-S%d-%s" % (outputHistFile, threshold, split, calcTypeNames[calcType]), "w") as fd:
+                table.dump_head(fd, "unknown", len(events))
+                table.dump_hist(fd)
+
+    return bank
+
 #-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 
 def smooth(x, windowLen, windowType="boxcar"):
@@ -89,6 +89,10 @@ def processImage(thresh, fileNames, grades=range(8), searchThresh=None, split=No
                  display=False, plot=True, subplots=False,
                  assembleCcd=None,      # not implemented
                  plotByAmp=None,        # not implemented
+                 integerPixels=None,    # not implemented
+                 eventCache=None,       # not implemented
+                 readThreads=None,      # not implemented
+                 peaksOnly=None,        # not implemented
                  ):
 
     events = []
@@ -119,6 +123,7 @@ def processImage(thresh, fileNames, grades=range(8), searchThresh=None, split=No
                 mi = image
             ds9.mtv(mi, title="bkgd subtracted", frame=0)
 
+        peakX, peakY = [], []
         for foot in fs.getFootprints():
             for i, peak in enumerate(foot.getPeaks()):
                 x, y = peak.getIx(), peak.getIy()
@@ -144,10 +149,11 @@ def processImage(thresh, fileNames, grades=range(8), searchThresh=None, split=No
                     except lsst.pex.exceptions.LsstCppException, e:
                         pass
 
-                try:
-                    events.append(ras.Event(image, afwGeom.PointI(x, y)))
-                except lsst.pex.exceptions.LsstCppException, e:
-                    pass
+                peakX.append(x)
+                peakY.append(y)
+        # Peaks too close to the edge are skipped
+        events += ras.EventExtractor().extractEvents(image, numpy.array(peakX, dtype=numpy.int32),
+                                                     numpy.array(peakY, dtype=numpy.int32))
 
     if emulateMedpict:
         def cmpEvents(a, b):
@@ -169,10 +175,7 @@ def processImage(thresh, fileNames, grades=range(8), searchThresh=None, split=No
     print "Passed %5d events" % (sum(status))
 
     if outputEventsFile:
-        with open(outputEventsFile, "w") as fd:
-            for stat, ev in zip(status, events):
-                if stat:
-                    print >> fd, "%d %d %d %d %g %d" % (ev.x, ev.y, ev.grade, ev.sum, ev[4], ev.p9)
+        fe55.writeEvents(outputEventsFile, [ev for stat, ev in zip(status, events) if stat])
 
     size = 1.6                          # half-size of box to draw
 
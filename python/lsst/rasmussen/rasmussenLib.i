@@ -29,7 +29,7 @@ Various swigged-up C++ classes for rasmussen
 %enddef
 
 %feature("autodoc", "1");
-%module(package="rasmussenLib", docstring=rasmussenLib_DOCSTRING) rasmussenLib
+%module(package="rasmussenLib", docstring=rasmussenLib_DOCSTRING, threads="1") rasmussenLib
 
 %pythonnondynamic;
 %naturalvar;  // use const reference typemaps
@@ -57,37 +57,159 @@ Various swigged-up C++ classes for rasmussen
 %}
 
 %declareNumPyConverters(ndarray::Array<int,2,2>);
+%declareNumPyConverters(ndarray::Array<int const,1,1>);
+%declareNumPyConverters(ndarray::Array<int,1,1>);
+%declareNumPyConverters(ndarray::Array<float,1,1>);
+%declareNumPyConverters(ndarray::Array<float,2,2>);
+%declareNumPyConverters(ndarray::Array<double const,1,1>);
 
 %shared_ptr(lsst::rasmussen::Fe55Control)
 %shared_ptr(data_str)
 %shared_ptr(lsst::rasmussen::Event)
+%shared_ptr(HistogramTable)
+%shared_ptr(lsst::rasmussen::FitsHdu)
 
 %{
 #include "lsst/rasmussen/Event.h"
+#include "lsst/rasmussen/extract.h"
+#include "lsst/rasmussen/peaks.h"
 #include "lsst/rasmussen/fe55.h"
 #include "lsst/rasmussen/tables.h"
+#include "lsst/rasmussen/columns.h"
+#include "lsst/rasmussen/filter.h"
+#include "lsst/rasmussen/sweep.h"
+#include "lsst/rasmussen/geometry.h"
+#include "lsst/rasmussen/assemble.h"
+#include "lsst/rasmussen/fitsReader.h"
+#include "lsst/rasmussen/instrument.h"
+#include "lsst/rasmussen/trace.h"
 %}
 
+/*
+ * Release the GIL in the calls that take long enough for other Python threads to make progress
+ * meanwhile (reading files, and the calls that work on a whole batch of events), so that a Python
+ * thread pool can run them on many cores at once;  all the other calls are too short for releasing
+ * and reacquiring the GIL to be worthwhile.
+ *
+ * None of these calls touch Python objects, and they're all safe to make from different threads
+ * as long as each thread has its own objects to modify (its own EventColumns, HistogramBank,
+ * EventExtractor, FitsReader, ...);  a HistogramTable that's only used to classify (i.e. passed
+ * to EventFilter.apply) may be shared, but one that's being filled may not.  The Instrumentation
+ * counters and the Trace are per-thread, so they don't need any care
+ */
+%nothread;
+%thread lsst::rasmussen::readEventFile;
+%thread lsst::rasmussen::writeEventFile;
+%thread lsst::rasmussen::EventExtractor::extractEvents;
+%thread lsst::rasmussen::PeakFinder::findPeaks;
+%thread lsst::rasmussen::EventColumns::append;
+%thread lsst::rasmussen::EventFilter::apply;
+%thread lsst::rasmussen::HistogramBank::process;
+%thread HistogramTable::countGrades;
+%thread HistogramTable::merge;
+%thread lsst::rasmussen::FitsReader::FitsReader;
+%thread lsst::rasmussen::FitsReader::next;
+%thread lsst::rasmussen::assembleCcd;
+%thread lsst::rasmussen::Trace::write;
+
 %include "lsst/rasmussen/rv.h"
 %include "lsst/rasmussen/Event.h"
-%include "lsst/rasmussen/fe55.h"
+%include "lsst/rasmussen/extract.h"
+%include "lsst/rasmussen/peaks.h"
 %include "lsst/rasmussen/tables.h"
+%include "lsst/rasmussen/fe55.h"
+%include "lsst/rasmussen/columns.h"
+%include "lsst/rasmussen/filter.h"
+%include "lsst/rasmussen/sweep.h"
+%include "lsst/rasmussen/geometry.h"
+%include "lsst/rasmussen/assemble.h"
+%include "lsst/rasmussen/fitsReader.h"
+%include "lsst/rasmussen/instrument.h"
+%include "lsst/rasmussen/trace.h"
 
 %template(vectorEvent) std::vector<boost::shared_ptr<lsst::rasmussen::Event> >;
+%template(vectorCalctype) std::vector<HistogramTable::calctype>;
+%template(vectorAmpGeometry) std::vector<lsst::rasmussen::AmpGeometry>;
+
+%extend lsst::rasmussen::Event {
+    %template(Event) Event<boost::uint16_t>;
+    %template(Event) Event<int>;
+    %template(Event) Event<float>;
+}
+
+%extend lsst::rasmussen::EventExtractor {
+    %template(extractEvents) extractEvents<boost::uint16_t>;
+    %template(extractEvents) extractEvents<int>;
+    %template(extractEvents) extractEvents<float>;
+}
 
+%extend lsst::rasmussen::PeakFinder {
+    %template(findPeaks) findPeaks<boost::uint16_t>;
+    %template(findPeaks) findPeaks<int>;
+    %template(findPeaks) findPeaks<float>;
+}
+
+/*
+ * Access to an Event's pixels without going through ctypes:  ev[i] reads one pixel, and
+ * ev.getArray() returns a numpy view of all nine (which keeps the Event alive).  For many
+ * events, put them in an EventColumns and use its getData(), getX(), ... which are numpy
+ * views of whole columns
+ */
 %extend lsst::rasmussen::Event {
+    float _getPixel(int i) const { return self->data[i]; }
+
+    static ndarray::Array<float,1,1> _getArray(boost::shared_ptr<lsst::rasmussen::Event> const& ev) {
+        return ndarray::external(ev->data, ndarray::makeVector(9), ndarray::makeVector(1), ev);
+    }
+
     %pythoncode {
-    def getData(self, *args):
-        """Access the int data[9] array (indexing on Event also works: ev[3])"""
-        i = args[0]
+    def getData(self, i):
+        """Return data[i] (indexing on Event also works: ev[3])"""
         if i < 0 or i >= 9:
             raise IndexError("Index %d is out of range 0..8" % i)
 
-        import ctypes
-        __data = 9*ctypes.c_float
-        __data = __data.from_address(int(self.data))
-        return __data[i]
+        return self._getPixel(i)
 
     __getitem__ = getData
+
+    def getArray(self):
+        """Return a numpy view of the Event's data[9]"""
+        return Event._getArray(self)
+    }
+}
+
+/*
+ * A HistogramTable's counts and histograms as a picklable dict, so that tables filled in other
+ * processes can be sent back and merged (see fe55.processImageSharded)
+ */
+%extend HistogramTable {
+    int _getCount(int grade) const { return self->counts[grade]; }
+    void _setCount(int grade, int n) { self->counts[grade] = n; }
+
+    %pythoncode {
+    _stateNames = ("ntotal", "noobnd", "nbevth", "nsatur", "ev_min", "xav", "yav",
+                   "min_adu", "max_adu", "min_2ct", "max_2ct", "xn", "xx", "yn", "yx")
+
+    def getState(self):
+        """Return the table's counts, histograms and bounds (but not its thresholds etc.) as a dict"""
+        state = dict((name, getattr(self, name)) for name in self._stateNames)
+        state["counts"] = [self._getCount(g) for g in range(self.NGRADE)]
+        state["histo"] = self.histo.copy()
+        return state
+
+    def setState(self, state):
+        """Set the table's counts, histograms and bounds from the result of getState()"""
+        for name in self._stateNames:
+            setattr(self, name, state[name])
+        for g, n in enumerate(state["counts"]):
+            self._setCount(g, n)
+        self.histo[:] = state["histo"]
+    }
+}
+
+%extend lsst::rasmussen::EventColumns {
+    %pythoncode {
+    def __len__(self):
+        return self.size()
     }
 }
@@ -0,0 +1,71 @@
+#
+# LSST Data Management System
+# Copyright 2008, 2009, 2010 LSST Corporation.
+#
+# This product includes software developed by the
+# LSST Project (http://www.lsstcorp.org/).
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the LSST License Statement and
+# the GNU General Public License along with this program.  If not,
+# see <http://www.lsstcorp.org/LegalNotices/>.
+#
+
+"""
+Record a timeline of a run, for viewing in chrome://tracing or Perfetto (ui.perfetto.dev)
+
+The C++ code records its own spans (reading HDUs and amps, searching frames) in the threads that do
+the work; use span() to add the python stages, e.g.
+    trace.start()
+    with trace.span("detect", "amp", file=fileName, hdu=hdu):
+        fs = afwDetect.FootprintSet(...)
+    trace.write("fe55.trace.json")
+Until start() is called a span costs a call to Trace.isEnabled()
+"""
+
+import contextlib
+import json
+
+import lsst.rasmussen as ras
+
+def start(threadName="python"):
+    """Start recording, naming the calling thread's row in the timeline threadName"""
+    ras.Trace.start()
+    ras.Trace.setThreadName(threadName)
+
+def write(fileName):
+    """Stop recording, and write the timeline to fileName"""
+    ras.Trace.stop()
+    ras.Trace.write(fileName)
+
+def now():
+    """The time, as span() and addSpan() want it"""
+    return ras.Trace.now()
+
+def addSpan(name, category, t0, **args):
+    """Record a span called name from t0 (as returned by now()) until now; see span()"""
+    if ras.Trace.isEnabled():
+        ras.Trace.addSpan(name, category, t0, ras.Trace.now(), json.dumps(args) if args else "")
+
+@contextlib.contextmanager
+def span(name, category, **args):
+    """Record the time spent in a with block as a span called name in the calling thread's timeline;
+    any keyword arguments are attached to the span (e.g. file=fileName, hdu=3)"""
+    if not ras.Trace.isEnabled():
+        yield
+        return
+
+    t0 = ras.Trace.now()
+    try:
+        yield
+    finally:
+        ras.Trace.addSpan(name, category, t0, ras.Trace.now(), json.dumps(args) if args else "")
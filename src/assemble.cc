@@ -0,0 +1,275 @@
+/*
+ * Assemble a CCD from its amps
+ */
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include "boost/format.hpp"
+#include "lsst/pex/exceptions.h"
+#include "lsst/afw/image/Image.h"
+#include "lsst/afw/math/Statistics.h"
+#include "lsst/rasmussen/assemble.h"
+#include "lsst/rasmussen/fitsReader.h"
+#include "lsst/rasmussen/instrument.h"
+#include "lsst/rasmussen/trace.h"
+
+namespace afwImage = lsst::afw::image;
+namespace afwMath = lsst::afw::math;
+
+namespace lsst {
+namespace rasmussen {
+
+namespace {
+    /*
+     * What a thread needs to do its share of the amps
+     */
+    struct Job {
+        FitsSource const *source;
+        std::vector<AmpGeometry> const *amps;
+        ndarray::Array<double const,1,1> gains;
+        bool trim;
+        bool perRow;
+        afwImage::Image<float> *ccdImage;
+        int i0, stride;                 // process amps i0, i0 + stride, ...
+
+        std::string error;              // set if something went wrong
+    };
+
+    std::string
+    fitsError(int status)
+    {
+        char msg[FLEN_STATUS];
+        fits_get_errstatus(status, msg);
+        return msg;
+    }
+    /*
+     * Return the median of n values, averaging the central two if n is even (as numpy.median does)
+     */
+    double
+    median(float *vals, int n)
+    {
+        float *mid = vals + n/2;
+        std::nth_element(vals, mid, vals + n);
+        if (n%2 == 1) {
+            return *mid;
+        }
+        return 0.5*(static_cast<double>(*mid) + *std::max_element(vals, mid));
+    }
+    /*
+     * Read amp into buff, returning a cfitsio status
+     */
+    int
+    readAmp(fitsfile *fptr, AmpGeometry const& amp, std::vector<float> *buff)
+    {
+        int status = 0;
+        if (fits_movabs_hdu(fptr, 1 + amp.channel, NULL, &status)) {
+            return status;
+        }
+
+        long naxes[2] = {0, 0};
+        if (fits_get_img_size(fptr, 2, naxes, &status)) {
+            return status;
+        }
+        if (naxes[0] != amp.width || naxes[1] != amp.height) {
+            return BAD_NAXES;
+        }
+
+        long const npix = naxes[0]*naxes[1];
+        buff->resize(npix);
+        int anynul = 0;
+        fits_read_img(fptr, TFLOAT, 1, npix, NULL, &(*buff)[0], &anynul, &status);
+
+        return status;
+    }
+    /*
+     * Bias subtract, trim, orient and gain-correct one amp (whose pixels are in buff) into ccdImage
+     */
+    void
+    processAmp(float *buff, AmpGeometry const& amp, double gain, bool trim, bool perRow,
+               afwImage::Image<float> *ccdImage)
+    {
+        int const x0 = trim ? amp.dataX0 : 0;
+        int const y0 = trim ? amp.dataY0 : 0;
+        int const width = trim ? amp.dataWidth : amp.width;
+        int const height = trim ? amp.dataHeight : amp.height;
+        /*
+         * The bias level;  if perRow it's set for each row as we go
+         */
+        double bias = 0.0;
+        std::vector<float> biasPixels;
+        if (trim) {
+            if (perRow) {
+                biasPixels.resize(amp.biasWidth);
+            } else {
+                biasPixels.reserve(amp.biasWidth*amp.biasHeight);
+                for (int y = 0; y != amp.biasHeight; ++y) {
+                    float const *row = buff + (amp.biasY0 + y)*amp.width + amp.biasX0;
+                    biasPixels.insert(biasPixels.end(), row, row + amp.biasWidth);
+                }
+                bias = afwMath::makeStatistics(biasPixels, afwMath::MEANCLIP).getValue();
+            }
+        }
+        /*
+         * Where the amp goes in the CCD, and how it's oriented.  Rotating by 180 degrees reverses
+         * both the rows and columns, and flipLR reverses the columns (again)
+         */
+        if (amp.rotate90%2 != 0) {
+            throw LSST_EXCEPT(lsst::pex::exceptions::InvalidParameterException,
+                              str(boost::format("Channel %d: I can't handle rotations by %d*90 degrees")
+                                  % amp.channel % amp.rotate90));
+        }
+        bool const rotated = (amp.rotate90%4 == 2);
+        bool const reverseX = (rotated != amp.flipLR);
+
+        int const cx0 = amp.iCol*width;
+        int const cy0 = amp.iRow*height;
+
+        for (int y = 0; y != height; ++y) {
+            float const *in = buff + (y0 + y)*amp.width + x0;
+
+            if (trim && perRow) {
+                float const *brow = buff + (amp.biasY0 + y)*amp.width + amp.biasX0;
+                std::copy(brow, brow + amp.biasWidth, biasPixels.begin());
+                bias = median(&biasPixels[0], amp.biasWidth);
+            }
+
+            int const cy = cy0 + (rotated ? height - 1 - y : y);
+            afwImage::Image<float>::x_iterator out = ccdImage->x_at(cx0, cy);
+            if (reverseX) {
+                for (int x = width - 1; x >= 0; --x, ++out) {
+                    *out = static_cast<float>(in[x] - bias)/gain;
+                }
+            } else {
+                for (int x = 0; x != width; ++x, ++out) {
+                    *out = static_cast<float>(in[x] - bias)/gain;
+                }
+            }
+        }
+    }
+
+    void *
+    runJob(void *arg)
+    {
+        Job *job = static_cast<Job *>(arg);
+
+        fitsfile *fptr = NULL;
+        try {
+            fptr = job->source->open();
+        } catch(lsst::pex::exceptions::Exception &e) {
+            job->error = e.what();
+            return NULL;
+        }
+        int status = 0;
+
+        std::vector<float> buff;
+        for (unsigned int i = job->i0; i < job->amps->size(); i += job->stride) {
+            AmpGeometry const& amp = (*job->amps)[i];
+            Trace::Span span("amp", "amp");
+            span.addArg("file", job->source->getFileName());
+            span.addArg("channel", amp.channel);
+
+            if ((status = readAmp(fptr, amp, &buff)) != 0) {
+                job->error = str(boost::format("Unable to read channel %d from %s: %s")
+                                 % amp.channel % job->source->getFileName() % fitsError(status));
+                break;
+            }
+            try {
+                processAmp(&buff[0], amp, job->gains[i], job->trim, job->perRow, job->ccdImage);
+            } catch(lsst::pex::exceptions::Exception &e) {
+                job->error = e.what();
+                break;
+            }
+        }
+
+        status = 0;
+        fits_close_file(fptr, &status);
+
+        return NULL;
+    }
+}
+
+boost::shared_ptr<afwImage::Image<float> >
+assembleCcd(std::string const& fileName,
+            std::vector<AmpGeometry> const& amps,
+            ndarray::Array<double const,1,1> const& gains,
+            bool trim,
+            bool perRow,
+            int nThread
+           )
+{
+    LSST_RASMUSSEN_TIMER(timer, ASSEMBLE);
+    LSST_RASMUSSEN_TIMER_EVENTS(timer, 1);
+    Trace::Span span("assembleCcd", "file");
+    span.addArg("file", fileName);
+
+    if (gains.getSize<0>() != static_cast<int>(amps.size())) {
+        throw LSST_EXCEPT(lsst::pex::exceptions::LengthErrorException,
+                          str(boost::format("Saw %d gains for %d amps") % gains.getSize<0>() % amps.size()));
+    }
+    /*
+     * Find the size of the CCD
+     */
+    int nx = 0, ny = 0;
+    for (std::vector<AmpGeometry>::const_iterator ptr = amps.begin(); ptr != amps.end(); ++ptr) {
+        int const width = trim ? ptr->dataWidth : ptr->width;
+        int const height = trim ? ptr->dataHeight : ptr->height;
+
+        nx = std::max(nx, (ptr->iCol + 1)*width);
+        ny = std::max(ny, (ptr->iRow + 1)*height);
+    }
+    boost::shared_ptr<afwImage::Image<float> > ccdImage(new afwImage::Image<float>(nx, ny));
+
+    if (nThread <= 0 || nThread > static_cast<int>(amps.size())) {
+        nThread = amps.size();
+    }
+    if (!fits_is_reentrant()) {
+        nThread = 1;
+    }
+    if (nThread == 0) {
+        return ccdImage;
+    }
+
+    FitsSource const source(fileName); // decompresses gzipped files once, for all the threads
+
+    std::vector<Job> jobs(nThread);
+    for (int i = 0; i != nThread; ++i) {
+        Job& job = jobs[i];
+        job.source = &source;
+        job.amps = &amps;
+        job.gains = gains;
+        job.trim = trim;
+        job.perRow = perRow;
+        job.ccdImage = ccdImage.get();
+        job.i0 = i;
+        job.stride = nThread;
+    }
+
+    if (nThread == 1) {
+        runJob(&jobs[0]);
+    } else {
+        std::vector<pthread_t> threads(nThread);
+        int nStarted = 0;
+        for (; nStarted != nThread; ++nStarted) {
+            if (pthread_create(&threads[nStarted], NULL, runJob, &jobs[nStarted]) != 0) {
+                break;
+            }
+        }
+        for (int i = nStarted; i != nThread; ++i) { // couldn't start a thread; do its work ourselves
+            runJob(&jobs[i]);
+        }
+        for (int i = 0; i != nStarted; ++i) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+
+    for (int i = 0; i != nThread; ++i) {
+        if (!jobs[i].error.empty()) {
+            throw LSST_EXCEPT(lsst::pex::exceptions::IoErrorException, jobs[i].error);
+        }
+    }
+
+    return ccdImage;
+}
+
+}}
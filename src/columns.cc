@@ -0,0 +1,208 @@
+/*
+ * Events stored by column
+ */
+#include <cstring>
+#include <algorithm>
+#include "lsst/rasmussen/columns.h"
+
+namespace lsst {
+namespace rasmussen {
+
+namespace {
+    /*
+     * Return a copy of the first n elements of arr in a new array of length capacity
+     */
+    template<typename T>
+    ndarray::Array<T, 1, 1>
+    resize(ndarray::Array<T, 1, 1> const& arr, int n, int capacity)
+    {
+        ndarray::Array<T, 1, 1> out = ndarray::allocate(ndarray::makeVector(capacity));
+        std::copy(arr.getData(), arr.getData() + n, out.getData());
+        return out;
+    }
+    /*
+     * Return a view of the first n elements of arr
+     */
+    template<typename T>
+    ndarray::Array<T, 1, 1>
+    head(ndarray::Array<T, 1, 1> const& arr, int n)
+    {
+        return ndarray::external(arr.getData(), ndarray::makeVector(n), ndarray::makeVector(1), arr);
+    }
+}
+
+EventColumns::EventColumns(int capacity) : _size(0), _capacity(0)
+{
+    reserve(capacity);
+}
+
+/*
+ * Make room for at least capacity events
+ */
+void
+EventColumns::reserve(int capacity)
+{
+    if (capacity <= _capacity && !_data.isEmpty()) {
+        return;
+    }
+    if (capacity < 1) {
+        capacity = 1;
+    }
+
+    ndarray::Array<float, 2, 2> data = ndarray::allocate(ndarray::makeVector(capacity, 9));
+    std::copy(_data.getData(), _data.getData() + 9*_size, data.getData());
+    _data = data;
+
+    _framenum = resize(_framenum, _size, capacity);
+    _chipnum = resize(_chipnum, _size, capacity);
+    _x = resize(_x, _size, capacity);
+    _y = resize(_y, _size, capacity);
+    _mode = resize(_mode, _size, capacity);
+    _grade = resize(_grade, _size, capacity);
+    _sum = resize(_sum, _size, capacity);
+    _p9 = resize(_p9, _size, capacity);
+    _flags = resize(_flags, _size, capacity);
+    _map = resize(_map, _size, capacity);
+
+    _capacity = capacity;
+}
+
+/*
+ * Make room for n more events, doubling our capacity if we need to grow
+ */
+void
+EventColumns::_grow(int n)
+{
+    if (_size + n > _capacity) {
+        reserve(std::max(_size + n, 2*_capacity));
+    }
+}
+
+void
+EventColumns::push_back(data_str const& ev)
+{
+    _grow(1);
+
+    std::copy(ev.data, ev.data + 9, _data.getData() + 9*_size);
+    _framenum[_size] = ev.framenum;
+    _chipnum[_size] = ev.chipnum;
+    _x[_size] = ev.x;
+    _y[_size] = ev.y;
+    _mode[_size] = ev.mode;
+    _grade[_size] = Event::UNKNOWN;
+    _sum[_size] = 0.0;
+    _p9[_size] = 0.0;
+    _flags[_size] = 0;
+    _map[_size] = 0;
+
+    ++_size;
+}
+
+void
+EventColumns::push_back(Event const& ev)
+{
+    push_back(static_cast<data_str const&>(ev));
+    _flags[_size - 1] = ev.flags;       // whatever the classification, so we keep the EDGE flag
+    /*
+     * Keep ev's classification if it's consistent with the others (or is the first)
+     */
+    if (ev.classifiedBy.isValid()) {
+        if (!_classifiedBy.isValid()) {
+            setClassificationKey(ev.classifiedBy);
+        }
+        if (ev.classifiedBy == _classifiedBy) {
+            setClassification(_size - 1, ev);
+        }
+    }
+}
+
+void
+EventColumns::append(data_str const* evs, int n)
+{
+    _grow(n);
+    for (int i = 0; i != n; ++i) {
+        push_back(evs[i]);
+    }
+}
+
+void
+EventColumns::append(std::vector<boost::shared_ptr<Event> > const& evs)
+{
+    _grow(evs.size());
+    for (std::vector<boost::shared_ptr<Event> >::const_iterator ptr = evs.begin(); ptr != evs.end(); ++ptr) {
+        push_back(**ptr);
+    }
+}
+
+/*
+ * Return the i'th event in RV format.  Any padding is zeroed, so the result is safe to fwrite
+ */
+data_str
+EventColumns::getDataStr(int i) const
+{
+    data_str ev;
+    memset(&ev, '\0', sizeof(ev));
+
+    std::copy(_data.getData() + 9*i, _data.getData() + 9*(i + 1), ev.data);
+    ev.framenum = _framenum[i];
+    ev.chipnum = _chipnum[i];
+    ev.x = _x[i];
+    ev.y = _y[i];
+    ev.mode = _mode[i];
+
+    return ev;
+}
+
+Event
+EventColumns::getEvent(int i) const
+{
+    Event ev(getDataStr(i));
+    ev.grade = static_cast<Event::Grade>(_grade[i]);
+    ev.sum = _sum[i];
+    ev.p9 = _p9[i];
+    ev.flags = _flags[i];
+    if (isClassified(i)) {
+        ev.map = _map[i];
+        ev.classifiedBy = _classifiedBy;
+    }
+
+    return ev;
+}
+
+void
+EventColumns::setClassificationKey(ClassificationKey const& key)
+{
+    if (key == _classifiedBy) {
+        return;
+    }
+    _classifiedBy = key;
+    std::fill(_grade.getData(), _grade.getData() + _size, static_cast<int>(Event::UNKNOWN));
+}
+
+void
+EventColumns::setClassification(int i, Event const& ev)
+{
+    _grade[i] = ev.grade;
+    _sum[i] = ev.sum;
+    _p9[i] = ev.p9;
+    _flags[i] = ev.flags;
+    _map[i] = ev.map;
+}
+
+ndarray::Array<float, 2, 2>
+EventColumns::getData() const
+{
+    return ndarray::external(_data.getData(), ndarray::makeVector(_size, 9), ndarray::makeVector(9, 1), _data);
+}
+
+ndarray::Array<int, 1, 1> EventColumns::getFramenum() const { return head(_framenum, _size); }
+ndarray::Array<int, 1, 1> EventColumns::getChipnum() const { return head(_chipnum, _size); }
+ndarray::Array<int, 1, 1> EventColumns::getX() const { return head(_x, _size); }
+ndarray::Array<int, 1, 1> EventColumns::getY() const { return head(_y, _size); }
+ndarray::Array<int, 1, 1> EventColumns::getMode() const { return head(_mode, _size); }
+ndarray::Array<int, 1, 1> EventColumns::getGrade() const { return head(_grade, _size); }
+ndarray::Array<float, 1, 1> EventColumns::getSum() const { return head(_sum, _size); }
+ndarray::Array<float, 1, 1> EventColumns::getP9() const { return head(_p9, _size); }
+ndarray::Array<int, 1, 1> EventColumns::getFlags() const { return head(_flags, _size); }
+
+}}
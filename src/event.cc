@@ -1,5 +1,9 @@
 #include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include "boost/cstdint.hpp"
 #include "lsst/rasmussen/Event.h"
+#include "lsst/rasmussen/instrument.h"
 #include "lsst/pex/exceptions.h"
 #include "lsst/afw/image/Image.h"
 #include "lsst/afw/geom/Point.h"
@@ -7,15 +11,18 @@
 namespace lsst {
 namespace rasmussen {
 
-Event::Event(afw::image::Image<float> const& im,        // image containing event
+template<typename PixelT>
+Event::Event(afw::image::Image<PixelT> const& im,       // image containing event
              lsst::afw::geom::Point2I const& cen,       // central pixel
              int framenum_,                             // frame ID of image
-             int chipnum_                               // chip ID for image
-            ) : grade(UNKNOWN), sum(0.0), p9(0.0)
+             int chipnum_,                              // chip ID for image
+             double bias                                // bias level to subtract from pixel values
+            ) : grade(UNKNOWN), sum(0.0), p9(0.0), flags(0), map(0)
 
 {
     if (!im.getBBox(afw::image::PARENT).contains(cen - afw::geom::ExtentI(1, 1)) ||
         !im.getBBox(afw::image::PARENT).contains(cen + afw::geom::ExtentI(1, 1))) {
+        LSST_RASMUSSEN_REJECT(EDGE, 1);
         throw LSST_EXCEPT(lsst::pex::exceptions::OutOfRangeException,
                           str(boost::format("%d is too close to the edge of image of size %d")
                               % cen % im.getBBox(afw::image::PARENT)));
@@ -27,17 +34,20 @@ Event::Event(afw::image::Image<float> const& im,        // image containing even
     y = cen.getY();
     mode = 0;
 
-    afw::image::Image<float>::xy_locator imData = im.xy_at(cen.getX(), cen.getY());
+    typename afw::image::Image<PixelT>::xy_locator imData = im.xy_at(cen.getX() - im.getX0(),
+                                                                     cen.getY() - im.getY0());
     int i = 0;
-    data[i++] = imData(-1, -1);
-    data[i++] = imData( 0, -1);
-    data[i++] = imData( 1, -1);
-    data[i++] = imData(-1,  0);
-    data[i++] = imData( 0,  0);
-    data[i++] = imData( 1,  0);
-    data[i++] = imData(-1,  1);
-    data[i++] = imData( 0,  1);
-    data[i++] = imData( 1,  1);
+    data[i++] = imData(-1, -1) - bias;
+    data[i++] = imData( 0, -1) - bias;
+    data[i++] = imData( 1, -1) - bias;
+    data[i++] = imData(-1,  0) - bias;
+    data[i++] = imData( 0,  0) - bias;
+    data[i++] = imData( 1,  0) - bias;
+    data[i++] = imData(-1,  1) - bias;
+    data[i++] = imData( 0,  1) - bias;
+    data[i++] = imData( 1,  1) - bias;
+
+    LSST_RASMUSSEN_COUNT(EXTRACT, 1);
 }
 
 std::vector<PTR(Event)>
@@ -62,4 +72,51 @@ readEventFile(std::string const& fileName)
     return events;
 }
 
+void
+writeEventFile(std::string const& fileName, std::vector<PTR(Event)> const& events)
+{
+    FILE *fp = fopen(fileName.c_str(), "w");
+    if (!fp) {
+        throw LSST_EXCEPT(lsst::pex::exceptions::IoErrorException,
+                          str(boost::format("Unable to open %s for write")
+                              % fileName));
+    }
+
+    data_str event;
+    memset(&event, '\0', sizeof(event)); // the padding after mode is written too, so zero it
+    for (std::vector<PTR(Event)>::const_iterator ptr = events.begin(); ptr != events.end(); ++ptr) {
+        Event const& ev = **ptr;
+        std::copy(ev.data, ev.data + 9, event.data);
+        event.framenum = ev.framenum;
+        event.chipnum = ev.chipnum;
+        event.x = ev.x;
+        event.y = ev.y;
+        event.mode = ev.mode;
+        if (fwrite((void *)&event, sizeof(data_str), 1, fp) != 1) {
+            fclose(fp);
+            throw LSST_EXCEPT(lsst::pex::exceptions::IoErrorException,
+                              str(boost::format("Error writing %s") % fileName));
+        }
+    }
+
+    if (fclose(fp) != 0) {
+        throw LSST_EXCEPT(lsst::pex::exceptions::IoErrorException,
+                          str(boost::format("Error closing %s") % fileName));
+    }
+}
+
+/************************************************************************************************************/
+//
+// Explicit instantiations
+//
+#define INSTANTIATE(PIXEL_T)                                            \
+    template Event::Event(afw::image::Image<PIXEL_T> const& im,        \
+                          lsst::afw::geom::Point2I const& cen,          \
+                          int framenum_, int chipnum_, double bias)
+
+INSTANTIATE(boost::uint16_t);
+INSTANTIATE(int);
+INSTANTIATE(float);
+INSTANTIATE(double);
+
 }}
@@ -0,0 +1,113 @@
+/*
+ * Extract the 3x3 stamps around a list of peaks
+ */
+#include <cstring>
+#include <algorithm>
+#include "boost/cstdint.hpp"
+#include "boost/format.hpp"
+#include "lsst/pex/exceptions.h"
+#include "lsst/afw/image/Image.h"
+#include "lsst/rasmussen/extract.h"
+#include "lsst/rasmussen/instrument.h"
+
+namespace lsst {
+namespace rasmussen {
+
+template<typename PixelT>
+std::vector<boost::shared_ptr<Event> >
+EventExtractor::extractEvents(afw::image::Image<PixelT> const& im,
+                              ndarray::Array<int const, 1, 1> const& x,
+                              ndarray::Array<int const, 1, 1> const& y,
+                              int framenum,
+                              int chipnum,
+                              double bias
+                             )
+{
+    int const n = x.getSize<0>();
+    if (y.getSize<0>() != n) {
+        throw LSST_EXCEPT(lsst::pex::exceptions::LengthErrorException,
+                          str(boost::format("Saw %d x and %d y values") % n % y.getSize<0>()));
+    }
+    _nEdge = _nSkipped = 0;
+
+    int const x0 = im.getX0(), y0 = im.getY0();
+    int const width = im.getWidth(), height = im.getHeight();
+
+    data_str ds;
+    memset(&ds, '\0', sizeof(ds));
+    ds.framenum = framenum;
+    ds.chipnum = chipnum;
+
+    std::vector<boost::shared_ptr<Event> > events;
+    events.reserve(n);
+    for (int i = 0; i != n; ++i) {
+        int const ix = x[i] - x0, iy = y[i] - y0; // position within im
+        if (ix < 0 || ix >= width || iy < 0 || iy >= height) {
+            ++_nSkipped;
+            continue;
+        }
+        bool const interior = (ix >= 1 && ix < width - 1 && iy >= 1 && iy < height - 1);
+        if (!interior) {
+            ++_nEdge;
+            if (_edgePolicy == SKIP) {
+                ++_nSkipped;
+                continue;
+            }
+        }
+
+        ds.x = x[i];
+        ds.y = y[i];
+        if (interior) {                 // the usual case:  three contiguous rows
+            for (int dy = -1; dy <= 1; ++dy) {
+                typename afw::image::Image<PixelT>::x_iterator const row = im.row_begin(iy + dy) + (ix - 1);
+                float *data = ds.data + 3*(dy + 1);
+                data[0] = row[0] - bias;
+                data[1] = row[1] - bias;
+                data[2] = row[2] - bias;
+            }
+        } else {
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    int px = ix + dx, py = iy + dy;
+                    float val = 0.0;
+                    if (px >= 0 && px < width && py >= 0 && py < height) {
+                        val = im(px, py) - bias;
+                    } else if (_edgePolicy == CLAMP) {
+                        px = std::min(std::max(px, 0), width - 1);
+                        py = std::min(std::max(py, 0), height - 1);
+                        val = im(px, py) - bias;
+                    }
+                    ds.data[(dx + 1) + 3*(dy + 1)] = val;
+                }
+            }
+        }
+
+        events.push_back(boost::shared_ptr<Event>(new Event(ds)));
+        if (!interior && _edgePolicy == FLAG) {
+            events.back()->flags = Event::EDGE;
+        }
+    }
+
+    LSST_RASMUSSEN_COUNT(EXTRACT, events.size());
+    LSST_RASMUSSEN_REJECT(EDGE, _nSkipped);
+
+    return events;
+}
+
+/************************************************************************************************************/
+//
+// Explicit instantiations
+//
+#define INSTANTIATE(PIXEL_T)                                                                    \
+    template std::vector<boost::shared_ptr<Event> >                                             \
+    EventExtractor::extractEvents(afw::image::Image<PIXEL_T> const& im,                        \
+                                  ndarray::Array<int const, 1, 1> const& x,                     \
+                                  ndarray::Array<int const, 1, 1> const& y,                     \
+                                  int framenum, int chipnum, double bias)
+
+INSTANTIATE(boost::uint16_t);
+INSTANTIATE(int);
+INSTANTIATE(float);
+INSTANTIATE(double);
+
+}}
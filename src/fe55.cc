@@ -27,16 +27,12 @@
  */
 
 #include "lsst/pex/exceptions.h"
-#include "lsst/pex/logging/Trace.h"
 #include "lsst/afw/image.h"
-#include "lsst/afw/detection/Psf.h"
-#include "lsst/meas/algorithms/Measure.h"
-#include "lsst/meas/algorithms/CentroidControl.h"
+#include "lsst/afw/table/Source.h"
+#include "lsst/meas/algorithms/Algorithm.h"
+#include "lsst/rasmussen/Event.h"
 #include "lsst/rasmussen/fe55.h"
 
-namespace pexExceptions = lsst::pex::exceptions;
-namespace pexLogging = lsst::pex::logging;
-namespace afwDet = lsst::afw::detection;
 namespace afwImage = lsst::afw::image;
 
 namespace lsst {
@@ -44,15 +40,17 @@ namespace rasmussen {
 
 namespace {
 /**
- * @brief A class that knows how to calculate centroids by guessing the wrong answer
+ * @brief A class that classifies each source as an Fe55 (or other X-ray) event
+ *
+ * The HistogramTable that does the classifying is made once, when the algorithm is, and each
+ * source's Event lives on the stack, so nothing is allocated per source
  */
-class Fe55 : public lsst::meas::algorithms::CentroidAlgorithm {
+class Fe55 : public lsst::meas::algorithms::Algorithm {
 public:
 
     Fe55(
         Fe55Control const & ctrl,
-        afw::table::Schema & schema,
-        lsst::meas::algorithms::AlgorithmControlMap const & others
+        afw::table::Schema & schema
                  );
 private:
     
@@ -65,14 +63,17 @@ private:
     
     LSST_MEAS_ALGORITHM_PRIVATE_INTERFACE(Fe55);
 
-    int _dX, _dY;
+    HistogramTable _table;
+    afw::table::Key<int> _gradeKey;
+    afw::table::Key<float> _sumKey;
+    afw::table::Key<float> _p9Key;
+    afw::table::Key<int> _evflagsKey;
+    afw::table::Key<afw::table::Flag> _flagKey;
 };
 
 /**
- * Given an image and a pixel position, return a Centroid offset by (nOthers, dY) from initial position,
- * where nOthers is the number of algorithms registered before this one.  This is just a trick to
- * return something about the previously registered algorithms to the Python test code when it
- * doesn't have access to the algorithm class.
+ * Given an image and a pixel position, extract the 3x3 stamp centred on the pixel containing the
+ * position, classify it, and set the source's grade, sum, p9 and flags
  */
 template <typename PixelT>
 void Fe55::_apply(
@@ -80,20 +81,46 @@ void Fe55::_apply(
     afw::image::Exposure<PixelT> const & exposure,
     afw::geom::Point2D const & center
 ) const {
-    source.set(getKeys().meas, center + afw::geom::Extent2D(_dX, _dY));
-    source.set(getKeys().flag, false);
+    source.set(_flagKey, true);         // say we failed until we succeed
+    source.set(_gradeKey, static_cast<int>(Event::UNKNOWN));
+
+    afwImage::Image<PixelT> const& im = *exposure.getMaskedImage().getImage();
+    afw::geom::Point2I const cen(afwImage::positionToIndex(center.getX()),
+                                 afwImage::positionToIndex(center.getY()));
+    afw::geom::Box2I const bbox = im.getBBox(afwImage::PARENT);
+    if (!bbox.contains(cen - afw::geom::Extent2I(1, 1)) || !bbox.contains(cen + afw::geom::Extent2I(1, 1))) {
+        return;                         // Event would throw, and we don't want to pay for the exception
+    }
+
+    Event ev(im, cen);
+    _table.classify(&ev);
+
+    source.set(_gradeKey, static_cast<int>(ev.grade));
+    source.set(_sumKey, ev.sum);
+    source.set(_p9Key, ev.p9);
+    source.set(_evflagsKey, ev.flags);
+    source.set(_flagKey, ev.flags != 0);
 }
 
 LSST_MEAS_ALGORITHM_PRIVATE_IMPLEMENTATION(Fe55);
 
 Fe55::Fe55(
         Fe55Control const & ctrl,
-        afw::table::Schema & schema,
-        lsst::meas::algorithms::AlgorithmControlMap const & others
+        afw::table::Schema & schema
                             ) :
-    lsst::meas::algorithms::CentroidAlgorithm((lsst::meas::algorithms::CentroidControl const &)ctrl, schema, "silly centroid docs"),
-    _dX(others.size()), _dY(ctrl.dY)
-{}
+    lsst::meas::algorithms::Algorithm(ctrl),
+    _table(0, ctrl.split, static_cast<HistogramTable::RESET_STYLES>(ctrl.resetStyle), ctrl.resetCoeff, ~0,
+           static_cast<HistogramTable::calctype>(ctrl.calctype)),
+    _gradeKey(schema.addField<int>(ctrl.name + ".grade", "event's grade (see rasmussen::Event::Grade)")),
+    _sumKey(schema.addField<float>(ctrl.name + ".sum", "event's sum, as given by calctype", "dn")),
+    _p9Key(schema.addField<float>(ctrl.name + ".p9", "sum of all 9 pixels in the event", "dn")),
+    _evflagsKey(schema.addField<int>(ctrl.name + ".evflags", "event's flags (see rasmussen::Event::Flags)")),
+    _flagKey(schema.addField<afw::table::Flag>(ctrl.name + ".flags",
+                                                "set if the event couldn't be extracted, or was flagged"))
+{
+    _table.setPixelType(static_cast<HistogramTable::pixeltype>(ctrl.pixelType));
+    _table.setSaturation(ctrl.saturation);
+}
 } // anonymous
 
 PTR(lsst::meas::algorithms::Algorithm) Fe55Control::_makeAlgorithm(
@@ -102,8 +129,7 @@ PTR(lsst::meas::algorithms::Algorithm) Fe55Control::_makeAlgorithm(
         lsst::meas::algorithms::AlgorithmControlMap const & other
                                                    ) const
 {
-    return boost::make_shared<Fe55>(*this, boost::ref(schema), other);
+    return boost::make_shared<Fe55>(*this, boost::ref(schema));
 }
     
 }}
-
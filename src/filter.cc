@@ -0,0 +1,167 @@
+/*
+ * Select events from an EventColumns, in the manner of rv_gflt
+ */
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include "lsst/rasmussen/filter.h"
+#include "lsst/rasmussen/instrument.h"
+#include "lsst/rasmussen/trace.h"
+
+namespace lsst {
+namespace rasmussen {
+
+namespace {
+    /*
+     * Clear keep[i] unless lo <= col[i] < hi.  There are no branches, so the compiler can vectorise it
+     */
+    template<typename T>
+    void
+    cut(T const *col, int const n, T const lo, T const hi, unsigned char *keep)
+    {
+        if (lo == -std::numeric_limits<T>::max() && hi == std::numeric_limits<T>::max()) {
+            return;                     // no cut requested
+        }
+        for (int i = 0; i < n; ++i) {
+            keep[i] &= (col[i] >= lo) & (col[i] < hi);
+        }
+    }
+
+    template<typename T>
+    void
+    cut(ndarray::Array<T, 1, 1> const& col, T const lo, T const hi, unsigned char *keep)
+    {
+        cut<T>(col.getData(), col.template getSize<0>(), lo, hi, keep);
+    }
+}
+
+EventFilter::EventFilter() :
+    _grades(~0),
+    _phaLo(-std::numeric_limits<float>::max()), _phaHi(std::numeric_limits<float>::max()),
+    _p9Lo(-std::numeric_limits<float>::max()), _p9Hi(std::numeric_limits<float>::max()),
+    _xLo(-std::numeric_limits<int>::max()), _xHi(std::numeric_limits<int>::max()),
+    _yLo(-std::numeric_limits<int>::max()), _yHi(std::numeric_limits<int>::max()),
+    _frameLo(-std::numeric_limits<int>::max()), _frameHi(std::numeric_limits<int>::max()),
+    _chipLo(-std::numeric_limits<int>::max()), _chipHi(std::numeric_limits<int>::max())
+{
+}
+
+ndarray::Array<int, 1, 1>
+EventFilter::apply(EventColumns & events,
+                   HistogramTable const& table
+                  ) const
+{
+    int const n = events.size();
+    Trace::Span span("EventFilter::apply", "events");
+    span.addArg("nevent", n);
+    std::vector<unsigned char> keep(n + 1); // +1 so &keep[0] is valid even if n == 0
+    std::vector<int> candidates;
+    /*
+     * Cuts on the raw events.  The cuts are timed as HISTOGRAM, and only the classification as CLASSIFY
+     */
+    {
+        LSST_RASMUSSEN_TIMER(timer, HISTOGRAM);
+
+        ndarray::Array<float, 2, 2> const data = events.getData();
+        float const event = table.getEventThreshold();
+        float const *p4 = data.getData() + 4;
+        for (int i = 0; i < n; ++i) {
+            keep[i] = (p4[9*i] >= event);
+        }
+#if !defined(LSST_RASMUSSEN_NO_INSTRUMENTATION)
+        int const nAbove = std::count(keep.begin(), keep.begin() + n, 1);
+        LSST_RASMUSSEN_REJECT(BELOW_THRESHOLD, n - nAbove);
+#endif
+        cut(events.getX(), _xLo, _xHi, &keep[0]);
+        cut(events.getY(), _yLo, _yHi, &keep[0]);
+        cut(events.getFramenum(), _frameLo, _frameHi, &keep[0]);
+        cut(events.getChipnum(), _chipLo, _chipHi, &keep[0]);
+
+        candidates.reserve(n);
+        for (int i = 0; i < n; ++i) {
+            if (keep[i]) {
+                candidates.push_back(i);
+            }
+        }
+#if !defined(LSST_RASMUSSEN_NO_INSTRUMENTATION)
+        LSST_RASMUSSEN_REJECT(ROI, nAbove - static_cast<int>(candidates.size()));
+#endif
+    }
+    int const nc = candidates.size();
+    /*
+     * Classify the survivors (unless events already has their classifications), recording the results
+     * both in events and densely so that the remaining cuts can run down contiguous arrays
+     */
+    events.setClassificationKey(table.getClassificationKey());
+
+    ndarray::Array<int, 1, 1> const grade = events.getGrade();
+    ndarray::Array<float, 1, 1> const sum = events.getSum();
+    ndarray::Array<float, 1, 1> const p9 = events.getP9();
+    ndarray::Array<int, 1, 1> const flags = events.getFlags();
+
+    std::vector<int> cGradeBit(nc + 1);
+    std::vector<int> cFlags(nc + 1);
+    std::vector<float> cSum(nc + 1);
+    std::vector<float> cP9(nc + 1);
+    {
+        LSST_RASMUSSEN_TIMER(timer, CLASSIFY);
+
+        for (int k = 0; k < nc; ++k) {
+            int const i = candidates[k];
+            if (!events.isClassified(i)) {
+                Event ev(events.getDataStr(i));
+                ev.flags = flags[i];    // classify() keeps the EDGE flag
+                table.classify(&ev);
+                events.setClassification(i, ev);
+            }
+
+            cGradeBit[k] = (grade[i] == Event::UNKNOWN) ? 0 : (1 << grade[i]);
+            cFlags[k] = flags[i];
+            cSum[k] = sum[i];
+            cP9[k] = p9[i];
+        }
+    }
+    /*
+     * and the cuts on the classified events
+     */
+    LSST_RASMUSSEN_TIMER(timer, HISTOGRAM);
+
+    int const badFlags = Event::EDGE | Event::SATURATED | Event::OVERFLOWED;
+    for (int k = 0; k < nc; ++k) {
+        keep[k] = ((cGradeBit[k] & _grades) != 0) & ((cFlags[k] & badFlags) == 0);
+    }
+#if !defined(LSST_RASMUSSEN_NO_INSTRUMENTATION)
+    int nGraded = 0, nUngraded = 0, nEdge = 0;
+    for (int k = 0; k < nc; ++k) {
+        bool const graded = ((cGradeBit[k] & _grades) != 0);
+        nUngraded += (cGradeBit[k] == 0);
+        nGraded += graded;
+        nEdge += graded && (cFlags[k] & Event::EDGE);
+    }
+    int const nKept = std::count(keep.begin(), keep.begin() + nc, 1);
+    LSST_RASMUSSEN_REJECT(UNGRADED, nUngraded);
+    LSST_RASMUSSEN_REJECT(GRADE_FILTER, nc - nGraded - nUngraded);
+    LSST_RASMUSSEN_REJECT(EDGE, nEdge); // as HistogramTable::accumulate, EDGE takes precedence
+    LSST_RASMUSSEN_REJECT(SATURATED, nGraded - nEdge - nKept);
+#endif
+    cut(&cSum[0], nc, _phaLo, _phaHi, &keep[0]);
+    cut(&cP9[0], nc, _p9Lo, _p9Hi, &keep[0]);
+
+    int npass = 0;
+    for (int k = 0; k < nc; ++k) {
+        npass += keep[k];
+    }
+#if !defined(LSST_RASMUSSEN_NO_INSTRUMENTATION)
+    LSST_RASMUSSEN_REJECT(PHA_RANGE, nKept - npass);
+#endif
+    ndarray::Array<int, 1, 1> selected = ndarray::allocate(ndarray::makeVector(npass));
+    for (int k = 0, j = 0; k < nc; ++k) {
+        if (keep[k]) {
+            selected[j++] = candidates[k];
+        }
+    }
+
+    return selected;
+}
+
+}}
@@ -0,0 +1,464 @@
+/*
+ * Read (possibly compressed) multi-extension FITS files, decompressing HDUs in parallel
+ */
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "boost/format.hpp"
+#include "lsst/pex/exceptions.h"
+#include "lsst/daf/base/PropertyList.h"
+#include "lsst/afw/image/Image.h"
+#include "lsst/rasmussen/fitsReader.h"
+#include "lsst/rasmussen/instrument.h"
+#include "lsst/rasmussen/trace.h"
+
+namespace afwImage = lsst::afw::image;
+namespace dafBase = lsst::daf::base;
+
+namespace lsst {
+namespace rasmussen {
+
+namespace {
+    std::string
+    fitsError(int status)
+    {
+        char msg[FLEN_STATUS];
+        fits_get_errstatus(status, msg);
+        return msg;
+    }
+    /*
+     * Is fileName gzipped?
+     */
+    bool
+    isGzipped(std::string const& fileName)
+    {
+        FILE *fd = fopen(fileName.c_str(), "rb");
+        if (fd == NULL) {
+            return false;               // let cfitsio complain
+        }
+        unsigned char magic[2] = {0, 0};
+        bool const gzipped = (fread(magic, 1, 2, fd) == 2 && magic[0] == 0x1f && magic[1] == 0x8b);
+        fclose(fd);
+
+        return gzipped;
+    }
+    /*
+     * Add a header card to md.  Comments, history, and blank cards are ignored
+     */
+    void
+    addCard(char const *card, dafBase::PropertyList *md)
+    {
+        if (strncmp(card + 8, "= ", 2) != 0) { // not a value card
+            return;
+        }
+        std::string name(card, 8);
+        name.erase(name.find_last_not_of(' ') + 1);
+
+        char cardCopy[FLEN_CARD];
+        strncpy(cardCopy, card, FLEN_CARD - 1);
+        cardCopy[FLEN_CARD - 1] = '\0';
+
+        char value[FLEN_VALUE], comment[FLEN_COMMENT];
+        int status = 0;
+        char dtype = 'C';
+        if (fits_parse_value(cardCopy, value, comment, &status) || value[0] == '\0' ||
+            fits_get_keytype(value, &dtype, &status)) {
+            return;                     // undefined or unparseable value
+        }
+
+        switch (dtype) {
+          case 'L':
+            md->set(name, value[0] == 'T');
+            break;
+          case 'I':
+            {
+                long long const ival = strtoll(value, NULL, 10);
+                if (ival == static_cast<int>(ival)) {
+                    md->set(name, static_cast<int>(ival));
+                } else {
+                    md->set(name, static_cast<double>(ival));
+                }
+            }
+            break;
+          case 'F':
+            for (char *ptr = value; *ptr != '\0'; ++ptr) {
+                if (*ptr == 'D' || *ptr == 'd') { // FORTRAN double exponent
+                    *ptr = 'E';
+                }
+            }
+            md->set(name, strtod(value, NULL));
+            break;
+          case 'C':
+            {
+                std::string sval;       // strip the quotes, and unescape quotes within the string
+                for (char const *ptr = value + 1; *ptr != '\0'; ++ptr) {
+                    if (*ptr == '\'') {
+                        if (ptr[1] != '\'') {
+                            break;
+                        }
+                        ++ptr;
+                    }
+                    sval += *ptr;
+                }
+                sval.erase(sval.find_last_not_of(' ') + 1);
+                md->set(name, sval);
+            }
+            break;
+          default:                      // complex values
+            md->set(name, std::string(value));
+            break;
+        }
+    }
+}
+
+/************************************************************************************************************/
+
+FitsSource::FitsSource(std::string const& fileName) :
+    _fileName(fileName), _buff(NULL), _buffSize(0), _fileSize(0), _mapped(false)
+{
+    if (!isGzipped(fileName)) {
+        /*
+         * Map the file;  cfitsio shares the innards of handles on the same file opened by name,
+         * so handles that are used by different threads must be opened on memory
+         */
+        int const fd = ::open(fileName.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            throw LSST_EXCEPT(lsst::pex::exceptions::IoErrorException,
+                              str(boost::format("Unable to open %s: %s") % fileName % strerror(errno)));
+        }
+        _fileSize = st.st_size;
+        _buff = mmap(NULL, _fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (_buff == MAP_FAILED) {
+            _buff = NULL;
+            throw LSST_EXCEPT(lsst::pex::exceptions::IoErrorException,
+                              str(boost::format("Unable to map %s: %s") % fileName % strerror(errno)));
+        }
+        _buffSize = _fileSize;
+        _mapped = true;
+    } else {
+        /*
+         * Decompress the file (all of it) into memory
+         */
+        fitsfile *in = NULL, *out = NULL;
+        int status = 0;
+        if (fits_open_file(&in, fileName.c_str(), READONLY, &status) == 0) {
+            _buffSize = 2880*1024;
+            _buff = malloc(_buffSize);
+            if (_buff == NULL) {
+                int cstatus = 0;
+                fits_close_file(in, &cstatus);
+                throw LSST_EXCEPT(lsst::pex::exceptions::MemoryException,
+                                  str(boost::format("Unable to allocate memory to decompress %s") % fileName));
+            }
+
+            fits_create_memfile(&out, &_buff, &_buffSize, 2880*1024, realloc, &status);
+            fits_copy_file(in, out, 1, 1, 1, &status);
+            /*
+             * The buffer may well be larger than the file;  remember where the last HDU ends so that
+             * cfitsio doesn't go looking for HDUs in the slack
+             */
+            LONGLONG headstart = 0, datastart = 0, dataend = 0;
+            fits_get_hduaddrll(out, &headstart, &datastart, &dataend, &status);
+            _fileSize = dataend;
+
+            int cstatus = 0;
+            fits_close_file(out, &cstatus); // the buffer survives, as we created it
+            fits_close_file(in, &cstatus);
+        }
+
+        if (status != 0) {
+            free(_buff);
+            _buff = NULL;
+            throw LSST_EXCEPT(lsst::pex::exceptions::IoErrorException,
+                              str(boost::format("Unable to decompress %s: %s") % fileName % fitsError(status)));
+        }
+    }
+
+    pthread_mutex_init(&_lock, NULL);
+}
+
+FitsSource::~FitsSource()
+{
+    pthread_mutex_destroy(&_lock);
+    if (_mapped) {
+        munmap(_buff, _buffSize);
+    } else {
+        free(_buff);
+    }
+}
+
+fitsfile *
+FitsSource::open() const
+{
+    /*
+     * cfitsio writes the buffer's address and size back through the pointers that we give it
+     * when the handle is closed, so each handle needs its own copies
+     */
+    pthread_mutex_lock(&_lock);
+    _handles.push_back(std::make_pair(_buff, _fileSize));
+    std::pair<void *, size_t>& handle = _handles.back();
+    pthread_mutex_unlock(&_lock);
+
+    fitsfile *fptr = NULL;
+    int status = 0;
+    if (fits_open_memfile(&fptr, _fileName.c_str(), READONLY, &handle.first, &handle.second, 0, NULL, &status)) {
+        throw LSST_EXCEPT(lsst::pex::exceptions::IoErrorException,
+                          str(boost::format("Unable to open %s: %s") % _fileName % fitsError(status)));
+    }
+
+    return fptr;
+}
+
+/************************************************************************************************************/
+
+FitsReader::FitsReader(std::string const& fileName, PixelType pixelType, int nThread) :
+    _source(new FitsSource(fileName)), _pixelType(pixelType),
+    _nextToRead(0), _nextToReturn(0), _window(0), _stop(false)
+{
+    /*
+     * Find the image HDUs
+     */
+    fitsfile *fptr = _source->open();
+    int status = 0;
+    for (int hdu = 1; status == 0; ++hdu) { // cfitsio only knows how many HDUs there are once it's seen them
+        int hduType = 0, naxis = 0;
+        fits_movabs_hdu(fptr, hdu, &hduType, &status);
+        if (status == 0 && hduType == IMAGE_HDU) { // tile-compressed images count as images
+            fits_get_img_dim(fptr, &naxis, &status);
+        }
+        if (status != 0 || naxis != 2) {
+            if (hdu == 1 && status == 0) { // an empty PDU
+                continue;
+            }
+            break;
+        }
+        _hdus.push_back(hdu);
+    }
+    int cstatus = 0;
+    fits_close_file(fptr, &cstatus);
+
+    _results.resize(_hdus.size());
+    _errors.resize(_hdus.size());
+    /*
+     * Start the workers
+     */
+    if (nThread == 0) {
+        nThread = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (nThread > size()) {
+        nThread = size();
+    }
+    if (nThread <= 0 || !fits_is_reentrant()) {
+        return;
+    }
+
+    pthread_mutex_init(&_lock, NULL);
+    pthread_cond_init(&_cond, NULL);
+    _window = nThread;
+
+    for (int i = 0; i != nThread; ++i) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, runWorker, this) != 0) {
+            break;
+        }
+        _threads.push_back(thread);
+    }
+    if (_threads.empty()) {
+        pthread_mutex_destroy(&_lock);
+        pthread_cond_destroy(&_cond);
+        _window = 0;
+    }
+}
+
+FitsReader::~FitsReader()
+{
+    if (_threads.empty()) {
+        return;
+    }
+
+    pthread_mutex_lock(&_lock);
+    _stop = true;
+    pthread_cond_broadcast(&_cond);
+    pthread_mutex_unlock(&_lock);
+
+    for (unsigned int i = 0; i != _threads.size(); ++i) {
+        pthread_join(_threads[i], NULL);
+    }
+    pthread_mutex_destroy(&_lock);
+    pthread_cond_destroy(&_cond);
+}
+
+/*
+ * Read an HDU.  Throws on error
+ */
+boost::shared_ptr<FitsHdu>
+FitsReader::read(fitsfile *fptr, int hdu) const
+{
+    LSST_RASMUSSEN_TIMER(timer, READ);
+    LSST_RASMUSSEN_TIMER_EVENTS(timer, 1);
+    Trace::Span span("read HDU", "hdu");
+    span.addArg("file", _source->getFileName());
+    span.addArg("hdu", hdu);
+
+    int status = 0;
+    long naxes[2] = {0, 0};
+    char *header = NULL;
+    int nkeys = 0;
+    fits_movabs_hdu(fptr, hdu, NULL, &status);
+    fits_get_img_size(fptr, 2, naxes, &status);
+    fits_convert_hdr2str(fptr, 0, NULL, 0, &header, &nkeys, &status); // the uncompressed header
+    if (status != 0) {
+        free(header);
+        throw LSST_EXCEPT(lsst::pex::exceptions::IoErrorException,
+                          str(boost::format("Unable to read HDU %d of %s: %s")
+                              % hdu % _source->getFileName() % fitsError(status)));
+    }
+
+    boost::shared_ptr<dafBase::PropertyList> md(new dafBase::PropertyList);
+    for (int i = 0; i != nkeys; ++i) {
+        addCard(header + 80*i, md.get());
+    }
+    free(header);
+    /*
+     * Read the pixels a row at a time, straight into the Image;  cfitsio keeps the last tile that
+     * it decompressed, so this doesn't decompress tiles more than once
+     */
+    boost::shared_ptr<afwImage::Image<float> > imageF;
+    boost::shared_ptr<afwImage::Image<boost::uint16_t> > imageU;
+    if (_pixelType == FLOAT) {
+        imageF.reset(new afwImage::Image<float>(naxes[0], naxes[1]));
+    } else {
+        imageU.reset(new afwImage::Image<boost::uint16_t>(naxes[0], naxes[1]));
+    }
+
+    for (int y = 0; y != naxes[1] && status == 0; ++y) {
+        long fpixel[2] = {1, y + 1};
+        if (imageF) {
+            fits_read_pix(fptr, TFLOAT, fpixel, naxes[0], NULL, &(*imageF->row_begin(y)), NULL, &status);
+        } else {
+            fits_read_pix(fptr, TUSHORT, fpixel, naxes[0], NULL, &(*imageU->row_begin(y)), NULL, &status);
+        }
+    }
+    if (status != 0) {
+        throw LSST_EXCEPT(lsst::pex::exceptions::IoErrorException,
+                          str(boost::format("Unable to read pixels from HDU %d of %s: %s")
+                              % hdu % _source->getFileName() % fitsError(status)));
+    }
+
+    return boost::shared_ptr<FitsHdu>(new FitsHdu(hdu, md, imageF, imageU));
+}
+
+void *
+FitsReader::runWorker(void *arg)
+{
+    static_cast<FitsReader *>(arg)->work();
+    return NULL;
+}
+/*
+ * A worker:  read the HDUs one by one, staying no more than _window HDUs ahead of the caller
+ */
+void
+FitsReader::work()
+{
+    if (Trace::isEnabled()) {
+        Trace::setThreadName("FitsReader worker");
+    }
+
+    fitsfile *fptr = NULL;
+    std::string openError;
+    try {
+        fptr = _source->open();
+    } catch(std::exception &e) {
+        openError = e.what();
+    }
+
+    pthread_mutex_lock(&_lock);
+    for (;;) {
+        while (!_stop && _nextToRead < size() && _nextToRead >= _nextToReturn + _window) {
+            pthread_cond_wait(&_cond, &_lock);
+        }
+        if (_stop || _nextToRead >= size()) {
+            break;
+        }
+        int const i = _nextToRead++;
+        pthread_mutex_unlock(&_lock);
+
+        boost::shared_ptr<FitsHdu> result;
+        std::string error = openError;
+        if (fptr != NULL) {
+            try {
+                result = read(fptr, _hdus[i]);
+            } catch(std::exception &e) {
+                error = e.what();
+            }
+        }
+
+        pthread_mutex_lock(&_lock);
+        _results[i] = result;
+        _errors[i] = error;
+        pthread_cond_broadcast(&_cond);
+    }
+    pthread_mutex_unlock(&_lock);
+
+    if (fptr != NULL) {
+        int status = 0;
+        fits_close_file(fptr, &status);
+    }
+}
+
+boost::shared_ptr<FitsHdu>
+FitsReader::next()
+{
+    if (_nextToReturn >= size()) {
+        return boost::shared_ptr<FitsHdu>();
+    }
+
+    if (_threads.empty()) {             // no workers; read it ourselves
+        fitsfile *fptr = _source->open();
+        boost::shared_ptr<FitsHdu> result;
+        try {
+            result = read(fptr, _hdus[_nextToReturn]);
+        } catch(...) {
+            int status = 0;
+            fits_close_file(fptr, &status);
+            throw;
+        }
+        int status = 0;
+        fits_close_file(fptr, &status);
+
+        ++_nextToReturn;
+        return result;
+    }
+
+    pthread_mutex_lock(&_lock);
+    int const i = _nextToReturn;
+    while (!_results[i] && _errors[i].empty()) {
+        pthread_cond_wait(&_cond, &_lock);
+    }
+    boost::shared_ptr<FitsHdu> result = _results[i];
+    std::string const error = _errors[i];
+    _results[i].reset();                // it's the caller's now
+    ++_nextToReturn;
+    pthread_cond_broadcast(&_cond);     // a worker may start on another HDU
+    pthread_mutex_unlock(&_lock);
+
+    if (!result) {
+        throw LSST_EXCEPT(lsst::pex::exceptions::IoErrorException, error);
+    }
+
+    return result;
+}
+
+}}
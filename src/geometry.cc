@@ -0,0 +1,174 @@
+/*
+ * The geometry of the amplifiers, from their FITS headers
+ */
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include <map>
+#include <string>
+#include "boost/format.hpp"
+#include "lsst/pex/exceptions.h"
+#include "lsst/daf/base/PropertySet.h"
+#include "lsst/rasmussen/geometry.h"
+
+namespace lsst {
+namespace rasmussen {
+
+namespace {
+    /*
+     * Numbers that aren't in the header
+     */
+    int const nRow = 2000;              // number of real rows of CCD pixels readout through an amp
+    int const nCol = 512;               // number of real columns of CCD pixels
+    int const data0 = 10;               // first column of real pixels
+    /*
+     * Set the data and bias sections, which are the same for all amps
+     */
+    void
+    setSections(AmpGeometry *geom)
+    {
+        geom->dataX0 = data0;
+        geom->dataY0 = 0;
+        geom->dataWidth = nCol;
+        geom->dataHeight = nRow;
+
+        geom->biasX0 = data0 + nCol;
+        geom->biasY0 = 0;
+        geom->biasWidth = geom->width - geom->biasX0;
+        geom->biasHeight = nRow;
+    }
+
+    double
+    getOptional(lsst::daf::base::PropertySet const& md, std::string const& name, double def)
+    {
+        return md.exists(name) ? md.getAsDouble(name) : def;
+    }
+    /*
+     * Do the work of getAmpGeometry(md)
+     */
+    AmpGeometry
+    makeAmpGeometry(int channel, std::string const& datasec,
+                    double ltv1, double ltv2, double ltm1_1, double ltm2_2, double ltm1_2, double ltm2_1)
+    {
+        AmpGeometry geom;
+        geom.channel = channel;
+
+        if (sscanf(datasec.c_str(), "[%*d:%d,%*d:%d]", &geom.width, &geom.height) != 2) {
+            throw LSST_EXCEPT(lsst::pex::exceptions::InvalidParameterException,
+                              str(boost::format("Unable to parse DATASEC %s") % datasec));
+        }
+
+        if (std::fabs(ltm1_1) != 1.0 || std::fabs(ltm2_2) != 1.0) {
+            throw LSST_EXCEPT(lsst::pex::exceptions::InvalidParameterException,
+                              str(boost::format("I refuse to handle non-square pixels: LTM = [[%g, %g], [%g, %g]]")
+                                  % ltm1_1 % ltm1_2 % ltm2_1 % ltm2_2));
+        }
+        if (ltm1_2 != 0.0 || ltm2_1 != 0.0) {
+            throw LSST_EXCEPT(lsst::pex::exceptions::InvalidParameterException,
+                              str(boost::format("I refuse to handle sheared detectors: LTM = [[%g, %g], [%g, %g]]")
+                                  % ltm1_1 % ltm1_2 % ltm2_1 % ltm2_2));
+        }
+
+        geom.rotate90 = 0;              // no need to rotate the amp to fit in the CCD
+        geom.flipLR = false;            // no need to flip the amp horizontally
+        if (ltm2_2 < 0) {
+            geom.rotate90 = 2;
+            geom.flipLR = true;
+        }
+        /*
+         * I think the camera team got the geometry wrong
+         * For channel 1 they have:
+         *   DATASEC : [1:542,1:2022]
+         *   DETSEC  : [0:542,0:2022]  (n.b. that's  543x2023)
+         *   DETSIZE : [0:4336,0:4044] (n.b. that's 4337x4045)
+         * If the 0 is correct, it implies that there's logically 1 pre-scan pixel so Cx starts at 0.0
+         * Note also that channel 16 has
+         *   LTV1 :  542
+         *   LTV2 : 4044
+         * which means that the pixel with (Ic, Il) == (542, 4044) maps to (Cx, Cy) = (0.0, 0.0)
+         * The problems with this theory are:
+         *   1. There are more than 1 overscan pixels (I think 10)
+         *   2. The size of the DETSEC and DETSIZE are wrong --- they should be e.g. [0:541, 0:2021]
+         *
+         * I think a more likely problem is that there's an off-by-one error in LTV[12] for the rotated
+         * channels at the top of the chip; I shall fix things with this assumption
+         */
+        if (geom.rotate90 == 2) {
+            ltv1 += 1;
+            ltv2 += 1;
+        }
+        /*
+         * LTM is diagonal with elements +-1, so it's its own inverse
+         */
+        double llc[2] = { ltm1_1*(1.0 - ltv1),        ltm2_2*(1.0 - ltv2) };
+        double urc[2] = { ltm1_1*(geom.width - ltv1), ltm2_2*(geom.height - ltv2) };
+        if (geom.rotate90 == 2) {
+            std::swap(llc[0], urc[0]);
+            std::swap(llc[1], urc[1]);
+        }
+        llc[0] -= 1; llc[1] -= 1;       // convert to C/C++/python/LSST 0-indexed convention
+
+        geom.iCol = static_cast<int>(std::floor(llc[0]/geom.width));
+        geom.iRow = static_cast<int>(std::floor(llc[1]/geom.height));
+
+        setSections(&geom);
+
+        return geom;
+    }
+}
+
+AmpGeometry const&
+getAmpGeometry(lsst::daf::base::PropertySet const& md)
+{
+    static std::map<std::string, AmpGeometry> cache;
+
+    int const channel = md.getAsInt("CHANNEL");
+    std::string const datasec = md.getAsString("DATASEC");
+    double const ltv1 = md.getAsDouble("LTV1");
+    double const ltv2 = md.getAsDouble("LTV2");
+    double const ltm1_1 = getOptional(md, "LTM1_1", 0.0);
+    double const ltm2_2 = getOptional(md, "LTM2_2", 0.0);
+    double const ltm1_2 = getOptional(md, "LTM1_2", 0.0);
+    double const ltm2_1 = getOptional(md, "LTM2_1", 0.0);
+
+    std::string const key = str(boost::format("%d %s %.17g %.17g %.17g %.17g %.17g %.17g")
+                                % channel % datasec % ltv1 % ltv2 % ltm1_1 % ltm2_2 % ltm1_2 % ltm2_1);
+
+    std::map<std::string, AmpGeometry>::const_iterator ptr = cache.find(key);
+    if (ptr == cache.end()) {
+        AmpGeometry const geom = makeAmpGeometry(channel, datasec, ltv1, ltv2, ltm1_1, ltm2_2, ltm1_2, ltm2_1);
+        ptr = cache.insert(std::make_pair(key, geom)).first;
+    }
+
+    return ptr->second;
+}
+
+AmpGeometry
+getAmpGeometry(int channel)
+{
+    AmpGeometry geom;
+    geom.channel = channel;
+    geom.width = 542;
+    geom.height = 2022;
+
+    if (channel >= 1 && channel <= 8) {
+        geom.iCol = channel - 1;
+        geom.iRow = 0;
+        geom.rotate90 = 0;              // Amp image is in the
+        geom.flipLR = false;            //    same orientation as the CCD image
+    } else if (channel >= 9 && channel <= 16) {
+        geom.iCol = 16 - channel;
+        geom.iRow = 1;
+        geom.rotate90 = 2;              // Amp image is rotated
+        geom.flipLR = true;             //     and flipped left-right relative to the CCD image
+    } else {
+        throw LSST_EXCEPT(lsst::pex::exceptions::OutOfRangeException,
+                          str(boost::format("Channel %d is not in 1..16") % channel));
+    }
+
+    setSections(&geom);
+
+    return geom;
+}
+
+}}
@@ -0,0 +1,259 @@
+/*
+ * Per-stage cycle counters and per-reason rejection counts;  see instrument.h
+ *
+ * This is linked into the rv_* programs too, so it mustn't use anything from the LSST stack
+ */
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include <pthread.h>
+#include <time.h>
+#include "lsst/rasmussen/instrument.h"
+
+namespace lsst {
+namespace rasmussen {
+
+__thread Instrumentation::Counters *Instrumentation::_counters = NULL;
+
+namespace {
+    typedef Instrumentation::Counters Counters;
+
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER; // protects everything below
+    std::vector<Counters *> live;                     // counters of running threads
+    Counters retired;                                 // sum of the counters of threads that have exited
+    Counters baseline;                                // totals at the last reset()
+
+    pthread_key_t key;
+    pthread_once_t keyOnce = PTHREAD_ONCE_INIT;
+
+    void
+    add(Counters & sum, Counters const& c)
+    {
+        for (int i = 0; i != Instrumentation::NSTAGE; ++i) {
+            sum.cycles[i] += c.cycles[i];
+            sum.calls[i] += c.calls[i];
+            sum.events[i] += c.events[i];
+        }
+        for (int i = 0; i != Instrumentation::NREASON; ++i) {
+            sum.rejected[i] += c.rejected[i];
+        }
+    }
+    /*
+     * The totals over all threads since the last reset().  The other threads may be counting while
+     * we read, so a total can be a few events behind (but no more)
+     */
+    Counters
+    totals()
+    {
+        Counters sum;
+        memset(&sum, '\0', sizeof(sum));
+
+        pthread_mutex_lock(&lock);
+        add(sum, retired);
+        for (std::vector<Counters *>::const_iterator ptr = live.begin(); ptr != live.end(); ++ptr) {
+            add(sum, **ptr);
+        }
+        Counters const base = baseline;
+        pthread_mutex_unlock(&lock);
+
+        for (int i = 0; i != Instrumentation::NSTAGE; ++i) {
+            sum.cycles[i] -= base.cycles[i];
+            sum.calls[i] -= base.calls[i];
+            sum.events[i] -= base.events[i];
+        }
+        for (int i = 0; i != Instrumentation::NREASON; ++i) {
+            sum.rejected[i] -= base.rejected[i];
+        }
+
+        return sum;
+    }
+
+    double
+    monotonicSeconds()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + 1e-9*ts.tv_nsec;
+    }
+    /*
+     * How fast readCycles() counts;  the TSC on any CPU that we care about ticks at a constant rate
+     */
+    double cyclesPerSecond = 0;
+    pthread_once_t calibrateOnce = PTHREAD_ONCE_INIT;
+
+    void
+    calibrate()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        double const t0 = monotonicSeconds();
+        boost::uint64_t const c0 = Instrumentation::readCycles();
+        struct timespec const nap = {0, 20000000}; // 20ms
+        nanosleep(&nap, NULL);
+        double const t1 = monotonicSeconds();
+        boost::uint64_t const c1 = Instrumentation::readCycles();
+
+        cyclesPerSecond = (c1 - c0)/(t1 - t0);
+#else
+        cyclesPerSecond = 1e9;          // readCycles() returns nanoseconds
+#endif
+    }
+
+    char const *stageNames[Instrumentation::NSTAGE] = {
+        "read", "assemble", "detect", "extract", "classify", "histogram",
+    };
+    char const *reasonNames[Instrumentation::NREASON] = {
+        "edge", "below_threshold", "roi", "ungraded", "grade_filter", "saturated", "out_of_bounds",
+        "pha_range",
+    };
+}
+
+Instrumentation::Counters *
+Instrumentation::_registerThread()
+{
+    pthread_once(&keyOnce, _makeKey);
+
+    Counters *c = new Counters;
+    memset(c, '\0', sizeof(*c));
+
+    pthread_mutex_lock(&lock);
+    live.push_back(c);
+    pthread_mutex_unlock(&lock);
+
+    pthread_setspecific(key, c);
+    _counters = c;
+
+    return c;
+}
+
+void
+Instrumentation::_makeKey()
+{
+    pthread_key_create(&key, _retireThread);
+}
+
+/*
+ * Called as a thread exits:  fold its counters into the retired totals
+ */
+void
+Instrumentation::_retireThread(void *counters)
+{
+    Counters *c = static_cast<Counters *>(counters);
+
+    pthread_mutex_lock(&lock);
+    add(retired, *c);
+    live.erase(std::remove(live.begin(), live.end(), c), live.end());
+    pthread_mutex_unlock(&lock);
+
+    _counters = NULL;                   // in case a later destructor counts something
+    delete c;
+}
+
+boost::uint64_t
+Instrumentation::readCycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int lo, hi;
+    __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+    return (static_cast<boost::uint64_t>(hi) << 32) | lo;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<boost::uint64_t>(ts.tv_sec)*1000000000 + ts.tv_nsec;
+#endif
+}
+
+bool
+Instrumentation::isEnabled()
+{
+#if defined(LSST_RASMUSSEN_NO_INSTRUMENTATION)
+    return false;
+#else
+    return true;
+#endif
+}
+
+double
+Instrumentation::getSeconds(Stage stage)
+{
+    pthread_once(&calibrateOnce, calibrate);
+    return totals().cycles[stage]/cyclesPerSecond;
+}
+
+boost::int64_t Instrumentation::getCalls(Stage stage) { return totals().calls[stage]; }
+boost::int64_t Instrumentation::getEvents(Stage stage) { return totals().events[stage]; }
+boost::int64_t Instrumentation::getRejected(Reason reason) { return totals().rejected[reason]; }
+
+double
+Instrumentation::getEventRate(Stage stage)
+{
+    double const seconds = getSeconds(stage);
+    return (seconds > 0) ? getEvents(stage)/seconds : 0.0;
+}
+
+std::string Instrumentation::getStageName(Stage stage) { return stageNames[stage]; }
+std::string Instrumentation::getReasonName(Reason reason) { return reasonNames[reason]; }
+
+void
+Instrumentation::addSeconds(Stage stage, double seconds, boost::int64_t nEvent)
+{
+#if !defined(LSST_RASMUSSEN_NO_INSTRUMENTATION)
+    pthread_once(&calibrateOnce, calibrate);
+    Counters *c = getCounters();
+    c->cycles[stage] += static_cast<boost::uint64_t>(seconds*cyclesPerSecond + 0.5);
+    ++c->calls[stage];
+    c->events[stage] += nEvent;
+#endif
+}
+
+void
+Instrumentation::addRejected(Reason reason, boost::int64_t n)
+{
+#if !defined(LSST_RASMUSSEN_NO_INSTRUMENTATION)
+    getCounters()->rejected[reason] += n;
+#endif
+}
+
+void
+Instrumentation::reset()
+{
+    Counters sum;
+    memset(&sum, '\0', sizeof(sum));
+
+    pthread_mutex_lock(&lock);
+    add(sum, retired);
+    for (std::vector<Counters *>::const_iterator ptr = live.begin(); ptr != live.end(); ++ptr) {
+        add(sum, **ptr);
+    }
+    baseline = sum;
+    pthread_mutex_unlock(&lock);
+}
+
+std::string
+Instrumentation::toJson()
+{
+    pthread_once(&calibrateOnce, calibrate);
+    Counters const c = totals();
+
+    std::string json = std::string("{\"enabled\": ") + (isEnabled() ? "true" : "false") + ", \"stages\": {";
+    char buff[200];
+    for (int i = 0; i != NSTAGE; ++i) {
+        double const seconds = c.cycles[i]/cyclesPerSecond;
+        sprintf(buff, "%s\"%s\": {\"seconds\": %.6g, \"calls\": %llu, \"events\": %llu, \"events_per_s\": %.6g}",
+                (i == 0 ? "" : ", "), stageNames[i],
+                seconds, static_cast<unsigned long long>(c.calls[i]), static_cast<unsigned long long>(c.events[i]),
+                (seconds > 0 ? c.events[i]/seconds : 0.0));
+        json += buff;
+    }
+    json += "}, \"rejected\": {";
+    for (int i = 0; i != NREASON; ++i) {
+        sprintf(buff, "%s\"%s\": %llu", (i == 0 ? "" : ", "), reasonNames[i],
+                static_cast<unsigned long long>(c.rejected[i]));
+        json += buff;
+    }
+    json += "}}";
+
+    return json;
+}
+
+}}
@@ -0,0 +1,105 @@
+/*
+ * Find the peaks above a threshold in an image;  see peaks.h
+ */
+#include <algorithm>
+#include "boost/cstdint.hpp"
+#include "lsst/afw/image/Image.h"
+#include "lsst/rasmussen/peaks.h"
+#include "lsst/rasmussen/instrument.h"
+
+namespace lsst {
+namespace rasmussen {
+
+template<typename PixelT>
+int
+PeakFinder::findPeaks(afw::image::Image<PixelT> const& im)
+{
+    LSST_RASMUSSEN_TIMER(timer, DETECT);
+
+    _x.clear();
+    _y.clear();
+    _values.clear();
+
+    int const x0 = im.getX0(), y0 = im.getY0();
+    int const width = im.getWidth(), height = im.getHeight();
+
+    typedef typename afw::image::Image<PixelT>::x_iterator x_iterator;
+    for (int y = 0; y != height; ++y) {
+        bool const haveBelow = (y > 0), haveAbove = (y < height - 1);
+        x_iterator const row = im.row_begin(y);
+        x_iterator const below = im.row_begin(haveBelow ? y - 1 : y);
+        x_iterator const above = im.row_begin(haveAbove ? y + 1 : y);
+
+        for (int x = 0; x != width; ++x) {
+            PixelT const val = row[x];
+            if (val < _threshold) {
+                continue;
+            }
+            /*
+             * Pixels before this one (in row order) must be lower, the ones after no higher
+             */
+            if ((x > 0 && !(val > row[x - 1])) || (x < width - 1 && !(val >= row[x + 1]))) {
+                continue;
+            }
+            int const xlo = std::max(x - 1, 0), xhi = std::min(x + 1, width - 1);
+            bool isPeak = true;
+            if (haveBelow) {
+                for (int i = xlo; i <= xhi; ++i) {
+                    if (!(val > below[i])) {
+                        isPeak = false;
+                        break;
+                    }
+                }
+            }
+            if (isPeak && haveAbove) {
+                for (int i = xlo; i <= xhi; ++i) {
+                    if (!(val >= above[i])) {
+                        isPeak = false;
+                        break;
+                    }
+                }
+            }
+            if (!isPeak) {
+                continue;
+            }
+
+            _x.push_back(x + x0);
+            _y.push_back(y + y0);
+            if (_findValues) {
+                _values.push_back(val);
+            }
+        }
+    }
+
+    LSST_RASMUSSEN_TIMER_EVENTS(timer, _x.size());
+    return _x.size();
+}
+
+namespace {
+    template<typename T>
+    ndarray::Array<T, 1, 1>
+    toArray(std::vector<T> const& vec)
+    {
+        ndarray::Array<T, 1, 1> arr = ndarray::allocate(ndarray::makeVector(static_cast<int>(vec.size())));
+        std::copy(vec.begin(), vec.end(), arr.begin());
+        return arr;
+    }
+}
+
+ndarray::Array<int, 1, 1> PeakFinder::getX() const { return toArray(_x); }
+ndarray::Array<int, 1, 1> PeakFinder::getY() const { return toArray(_y); }
+ndarray::Array<float, 1, 1> PeakFinder::getValues() const { return toArray(_values); }
+
+/************************************************************************************************************/
+//
+// Explicit instantiations
+//
+#define INSTANTIATE(PIXEL_T)                                                                    \
+    template int PeakFinder::findPeaks(afw::image::Image<PIXEL_T> const& im)
+
+INSTANTIATE(boost::uint16_t);
+INSTANTIATE(int);
+INSTANTIATE(float);
+INSTANTIATE(double);
+
+}}
@@ -0,0 +1,492 @@
+/*
+ *  rv_fe55sim.cc -- make synthetic Fe55 data:  multi-amp FITS frames, or an RV event stream
+ *
+ *	Frames are laid out as cameraGeom.makeAmp expects (one HDU per amp, with the CHANNEL,
+ *	DATASEC, LTV and LTM keywords that getAmpGeometry reads), or as medpict.makeAmp expects
+ *	(one 2116x1000 HDU with WIDTH and HEIGHT).  An event stream is a set of data_strs, as
+ *	written by medpict_lsst -e, with one event per X-ray (or cosmic ray).
+ *
+ *	Each X-ray is a K-alpha or K-beta photon;  a fraction of them share their charge with
+ *	a side neighbour, and a fraction of those spread into the perpendicular neighbour and the
+ *	corner between them (the L and square grades).  Cosmic rays are straight tracks.  The
+ *	frames have a bias level (which varies from amp to amp), read noise, and overclock.
+ *
+ *	The random numbers come from xorshift64* and the polar method, so a frame's pixels cost
+ *	a few ns each, and we can make data a lot faster than the pipeline can process it.
+ */
+#if defined(MAIN)
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include "boost/cstdint.hpp"
+#include "fitsio.h"
+#include "lsst/rasmussen/rvio.h"
+
+namespace {
+void
+usage()
+{
+    (void)fprintf(stderr, "Usage:  rv_fe55sim [-l camera|medpict|events] [-N nframe] [-n nxray] [-K kalpha kbeta]\n");
+    (void)fprintf(stderr, "                  [-k kbfrac] [-s splitfrac] [-c cornerfrac] [-r readnoise] [-b bias biasrms]\n");
+    (void)fprintf(stderr, "                  [-C ncosmic] [-S seed] [-T truth] [-o output]\n\n");
+    (void)fprintf(stderr, "\tlayout  == camera:  16 amp HDUs per file, as cameraGeom.makeAmp reads them (default)\n");
+    (void)fprintf(stderr, "\t           medpict: one 2116x1000 HDU per file, as medpict.makeAmp reads it\n");
+    (void)fprintf(stderr, "\t           events:  an RV event stream (16 amps' worth per frame)\n");
+    (void)fprintf(stderr, "\tnframe  == number of frames (default 1)\n");
+    (void)fprintf(stderr, "\tnxray   == mean number of X-rays per amp per frame (default 2000)\n");
+    (void)fprintf(stderr, "\tkalpha kbeta == energies of K-alpha and K-beta X-rays, in DN (default 1620 1778)\n");
+    (void)fprintf(stderr, "\tkbfrac  == fraction of X-rays that are K-beta (default 0.12)\n");
+    (void)fprintf(stderr, "\tsplitfrac  == fraction of X-rays split with a side neighbour (default 0.3)\n");
+    (void)fprintf(stderr, "\tcornerfrac == fraction of split X-rays that also spread into a corner (default 0.2)\n");
+    (void)fprintf(stderr, "\treadnoise  == read noise, in DN (default 5)\n");
+    (void)fprintf(stderr, "\tbias biasrms == mean bias (overclock) level, and its amp-to-amp rms (default 1000 20)\n");
+    (void)fprintf(stderr, "\tncosmic == mean number of cosmic rays per amp per frame (default 20)\n");
+    (void)fprintf(stderr, "\tseed    == random number seed (default 1)\n");
+    (void)fprintf(stderr, "\ttruth   == write the X-rays (and, in an event stream, cosmic rays) without noise to this RV event file\n");
+    (void)fprintf(stderr, "\toutput  == prefix of the files (default fe55sim-; the frame number and .fits are appended)\n");
+    (void)fprintf(stderr, "\t           or, for events, the event file (default: stdout)\n");
+}
+
+struct SimConfig {
+    SimConfig() : nxray(2000), kAlpha(1620), kBeta(1778), kBetaFrac(0.12), splitFrac(0.3), cornerFrac(0.2),
+                  readNoise(5), bias(1000), biasRms(20), ncosmic(20), crLength(20), crCharge(8000) {}
+
+    double nxray;                       // mean number of X-rays per amp per frame
+    double kAlpha, kBeta;               // X-ray energies, in DN
+    double kBetaFrac;                   // fraction of X-rays that are K-beta
+    double splitFrac;                   // fraction of X-rays whose charge is split with a side neighbour
+    double cornerFrac;                  // fraction of split X-rays that also spread into a corner
+    double readNoise;                   // read noise, in DN
+    double bias, biasRms;               // bias level, and its amp-to-amp rms
+    double ncosmic;                     // mean number of cosmic rays per amp per frame
+    double crLength;                    // mean length of a cosmic ray's track, in pixels
+    double crCharge;                    // mean charge deposited by a cosmic ray, in DN
+};
+/*
+ * Where the amps' pixels are.  The boxes are [x0, x0 + width) etc., 0-indexed
+ */
+struct Layout {
+    int namp;                           // number of amps (HDUs) per frame
+    int width, height;                  // size of each amp
+    int dataX0, dataWidth, dataHeight;  // the real pixels, starting at row 0
+};
+
+Layout const cameraLayout =  { 16, 542, 2022, 10, 512, 2000 }; // see geometry.cc
+Layout const medpictLayout = {  1, 2116, 1000, 50, 2065 - 50, 1000 }; // see medpict.makeAmp
+/*
+ * A fast, reproducible, random number generator
+ */
+class Random {
+public:
+    explicit Random(boost::uint64_t seed) : _state(seed ? seed : 0x9e3779b97f4a7c15ULL), _haveGauss(false) {}
+
+    boost::uint64_t next() {            // xorshift64*
+        _state ^= _state >> 12;
+        _state ^= _state << 25;
+        _state ^= _state >> 27;
+        return _state*0x2545f4914f6cdd1dULL;
+    }
+    double uniform() {                  // [0, 1)
+        return (next() >> 11)*(1.0/9007199254740992.0);
+    }
+    int uniformInt(int n) {             // [0, n)
+        return static_cast<int>(uniform()*n);
+    }
+    double gauss() {                    // N(0, 1), by the polar method
+        if (_haveGauss) {
+            _haveGauss = false;
+            return _gauss;
+        }
+        double u, v, s;
+        do {
+            u = 2*uniform() - 1;
+            v = 2*uniform() - 1;
+            s = u*u + v*v;
+        } while (s >= 1 || s == 0);
+        double const f = std::sqrt(-2*std::log(s)/s);
+        _gauss = v*f;
+        _haveGauss = true;
+        return u*f;
+    }
+    double exponential(double mean) {
+        return -mean*std::log(1 - uniform());
+    }
+    int poisson(double mean) {
+        if (mean > 50) {
+            return std::max(0, static_cast<int>(mean + std::sqrt(mean)*gauss() + 0.5));
+        }
+        double const limit = std::exp(-mean);
+        int n = 0;
+        for (double p = uniform(); p > limit; p *= uniform()) {
+            ++n;
+        }
+        return n;
+    }
+private:
+    boost::uint64_t _state;
+    bool _haveGauss;
+    double _gauss;
+};
+/*
+ * Set stamp (3x3, in data_str order) to the charge deposited by an X-ray, and return its energy
+ */
+double
+makeXray(Random & rand, SimConfig const& cfg, float stamp[9])
+{
+    std::fill(stamp, stamp + 9, 0.0f);
+    double const e = (rand.uniform() < cfg.kBetaFrac) ? cfg.kBeta : cfg.kAlpha;
+    if (rand.uniform() >= cfg.splitFrac) {
+        stamp[4] = e;
+        return e;
+    }
+
+    int const dx[4] = { 0, -1, 1, 0 }, dy[4] = { -1, 0, 0, 1 }; // the side neighbours 1, 3, 5, 7
+    int const side = rand.uniformInt(4);
+    double const f = 0.1 + 0.4*rand.uniform(); // fraction of the charge in the neighbour
+    if (rand.uniform() >= cfg.cornerFrac) {
+        stamp[4] = e*(1 - f);
+        stamp[(1 + dx[side]) + 3*(1 + dy[side])] = e*f;
+        return e;
+    }
+    /*
+     * Spread into a perpendicular neighbour too, and the corner between them
+     */
+    int const sign = (rand.uniform() < 0.5) ? -1 : 1;
+    int const pdx = dx[side] ? 0 : sign, pdy = dy[side] ? 0 : sign;
+    double const g = 0.1 + 0.3*rand.uniform(); // fraction of the charge in the perpendicular direction
+
+    stamp[4] = e*(1 - f)*(1 - g);
+    stamp[(1 + dx[side]) + 3*(1 + dy[side])] = e*f*(1 - g);
+    stamp[(1 + pdx) + 3*(1 + pdy)] = e*(1 - f)*g;
+    stamp[(1 + dx[side] + pdx) + 3*(1 + dy[side] + pdy)] = e*f*g;
+
+    return e;
+}
+/*
+ * Set stamp to the part of a cosmic ray's track that passes through the central pixel's neighbourhood
+ */
+void
+makeCosmicStamp(Random & rand, SimConfig const& cfg, float stamp[9])
+{
+    int const dirs[4][2] = { { 1, 0 }, { 0, 1 }, { 1, 1 }, { 1, -1 } };
+    int const *dir = dirs[rand.uniformInt(4)];
+    double const perPixel = rand.exponential(cfg.crCharge)/cfg.crLength;
+
+    std::fill(stamp, stamp + 9, 0.0f);
+    for (int i = -1; i <= 1; ++i) {
+        stamp[(1 + i*dir[0]) + 3*(1 + i*dir[1])] = perPixel*(0.5 + rand.uniform());
+    }
+}
+
+class Simulator {
+public:
+    Simulator(SimConfig const& cfg, Layout const& layout, boost::uint64_t seed, struct rv_writer *truth) :
+        _cfg(cfg), _layout(layout), _rand(seed), _truth(truth),
+        _charge(static_cast<size_t>(layout.width)*layout.height), _pixels(_charge.size()) {}
+    /*
+     * Fill pixels with one amp of a frame
+     */
+    std::vector<unsigned short> const& makeAmp(int frame, int channel);
+    /*
+     * Write one frame's worth of events
+     */
+    void writeEvents(struct rv_writer *w, int frame);
+private:
+    void addTruth(float const stamp[9], int frame, int channel, int x, int y);
+    void addStamp(float const stamp[9], int x, int y);
+    void addCosmic();
+
+    SimConfig _cfg;
+    Layout _layout;
+    Random _rand;
+    struct rv_writer *_truth;
+    std::vector<float> _charge;         // charge in each pixel of the amp
+    std::vector<unsigned short> _pixels; // the amp's pixels, as read out
+};
+
+void
+Simulator::addTruth(float const stamp[9], int frame, int channel, int x, int y)
+{
+    if (!_truth) {
+        return;
+    }
+    data_str ev;
+    memset(&ev, '\0', sizeof(ev));
+    std::copy(stamp, stamp + 9, ev.data);
+    ev.framenum = frame;
+    ev.chipnum = channel;
+    ev.x = x;
+    ev.y = y;
+    if (rv_write_events(_truth, &ev, 1) < 0) {
+        throw std::runtime_error("Unable to write the truth file");
+    }
+}
+/*
+ * Add a stamp centred at (x, y);  any part of it that isn't in the data section is lost
+ */
+void
+Simulator::addStamp(float const stamp[9], int x, int y)
+{
+    for (int yi = -1; yi <= 1; ++yi) {
+        int const yy = y + yi;
+        if (yy < 0 || yy >= _layout.dataHeight) continue;
+        for (int xi = -1; xi <= 1; ++xi) {
+            int const xx = x + xi;
+            if (xx < _layout.dataX0 || xx >= _layout.dataX0 + _layout.dataWidth) continue;
+            _charge[xx + static_cast<size_t>(yy)*_layout.width] += stamp[(xi + 1) + 3*(yi + 1)];
+        }
+    }
+}
+/*
+ * Add a straight cosmic ray track, starting in the data section
+ */
+void
+Simulator::addCosmic()
+{
+    double x = _layout.dataX0 + _layout.dataWidth*_rand.uniform();
+    double y = _layout.dataHeight*_rand.uniform();
+    double const theta = 2*M_PI*_rand.uniform();
+    double const length = _rand.exponential(_cfg.crLength);
+    int const nstep = std::max(1, static_cast<int>(2*length)); // half-pixel steps
+    double const charge = _rand.exponential(_cfg.crCharge)/nstep;
+    double const dx = 0.5*std::cos(theta), dy = 0.5*std::sin(theta);
+
+    for (int i = 0; i != nstep; ++i, x += dx, y += dy) {
+        int const ix = static_cast<int>(x), iy = static_cast<int>(y);
+        if (x < _layout.dataX0 || ix >= _layout.dataX0 + _layout.dataWidth || y < 0 || iy >= _layout.dataHeight) {
+            break;
+        }
+        _charge[ix + static_cast<size_t>(iy)*_layout.width] += charge;
+    }
+}
+
+std::vector<unsigned short> const&
+Simulator::makeAmp(int frame, int channel)
+{
+    std::fill(_charge.begin(), _charge.end(), 0.0f);
+
+    float stamp[9];
+    int const nxray = _rand.poisson(_cfg.nxray);
+    for (int i = 0; i != nxray; ++i) {
+        int const x = _layout.dataX0 + _rand.uniformInt(_layout.dataWidth);
+        int const y = _rand.uniformInt(_layout.dataHeight);
+        makeXray(_rand, _cfg, stamp);
+        addStamp(stamp, x, y);
+        addTruth(stamp, frame, channel, x, y);
+    }
+    int const ncosmic = _rand.poisson(_cfg.ncosmic);
+    for (int i = 0; i != ncosmic; ++i) {
+        addCosmic();
+    }
+    /*
+     * Read the amp out
+     */
+    double const bias = _cfg.bias + _cfg.biasRms*_rand.gauss();
+    for (size_t i = 0; i != _charge.size(); ++i) {
+        double const val = bias + _charge[i] + _cfg.readNoise*_rand.gauss() + 0.5;
+        _pixels[i] = (val <= 0) ? 0 : (val >= 65535) ? 65535 : static_cast<unsigned short>(val);
+    }
+
+    return _pixels;
+}
+
+void
+Simulator::writeEvents(struct rv_writer *w, int frame)
+{
+    data_str ev;
+    memset(&ev, '\0', sizeof(ev));
+    ev.framenum = frame;
+
+    for (int amp = 0; amp != _layout.namp; ++amp) {
+        ev.chipnum = amp + 1;
+
+        int const nxray = _rand.poisson(_cfg.nxray);
+        int const ncosmic = _rand.poisson(_cfg.ncosmic);
+        for (int i = 0; i != nxray + ncosmic; ++i) {
+            if (i < nxray) {
+                makeXray(_rand, _cfg, ev.data);
+            } else {
+                makeCosmicStamp(_rand, _cfg, ev.data);
+            }
+            ev.x = 1 + _layout.dataX0 + _rand.uniformInt(_layout.dataWidth - 2);
+            ev.y = 1 + _rand.uniformInt(_layout.dataHeight - 2);
+            addTruth(ev.data, frame, ev.chipnum, ev.x, ev.y);
+
+            for (int j = 0; j != 9; ++j) {
+                ev.data[j] = std::floor(ev.data[j] + _cfg.readNoise*_rand.gauss() + 0.5);
+            }
+            if (rv_write_events(w, &ev, 1) < 0) {
+                throw std::runtime_error("Unable to write events");
+            }
+        }
+    }
+}
+
+void
+checkFits(int status, std::string const& what)
+{
+    if (status != 0) {
+        char msg[FLEN_STATUS];
+        fits_get_errstatus(status, msg);
+        throw std::runtime_error(what + ": " + msg);
+    }
+}
+/*
+ * Write a frame to fileName, an HDU per amp
+ */
+void
+writeFrame(Simulator & sim, Layout const& layout, bool camera, int frame, std::string const& fileName)
+{
+    int status = 0;
+    fitsfile *fptr = NULL;
+    long naxes[2] = { layout.width, layout.height };
+
+    fits_create_file(&fptr, ("!" + fileName).c_str(), &status);
+    if (camera) {
+        fits_create_img(fptr, USHORT_IMG, 0, NULL, &status); // an empty PDU
+    }
+    for (int amp = 0; amp != layout.namp && status == 0; ++amp) {
+        int channel = amp + 1;
+        std::vector<unsigned short> const& pixels = sim.makeAmp(frame, channel);
+
+        fits_create_img(fptr, USHORT_IMG, 2, naxes, &status);
+        if (camera) {
+            /*
+             * Channels 1..8 are the bottom row of the CCD, left to right;  9..16 the top row, right
+             * to left and rotated by 180 degrees.  These are the LTV/LTM values that getAmpGeometry
+             * turns into that layout (including its off-by-one correction for the top row)
+             */
+            bool const top = (channel > 8);
+            int const iCol = top ? 16 - channel : channel - 1;
+            char datasec[80];
+            sprintf(datasec, "[1:%d,1:%d]", layout.width, layout.height);
+            double const ltm = top ? -1 : 1;
+            double const ltv1 = top ? layout.width*(iCol + 1) : -layout.width*iCol;
+            double const ltv2 = top ? 2*layout.height : 0;
+
+            fits_update_key(fptr, TINT, "CHANNEL", &channel, "amplifier channel", &status);
+            fits_update_key(fptr, TSTRING, "DATASEC", datasec, "all the pixels", &status);
+            fits_update_key(fptr, TDOUBLE, "LTV1", const_cast<double *>(&ltv1), NULL, &status);
+            fits_update_key(fptr, TDOUBLE, "LTV2", const_cast<double *>(&ltv2), NULL, &status);
+            fits_update_key(fptr, TDOUBLE, "LTM1_1", const_cast<double *>(&ltm), NULL, &status);
+            fits_update_key(fptr, TDOUBLE, "LTM2_2", const_cast<double *>(&ltm), NULL, &status);
+        } else {
+            int width = layout.width, height = layout.height;
+            fits_update_key(fptr, TINT, "WIDTH", &width, NULL, &status);
+            fits_update_key(fptr, TINT, "HEIGHT", &height, NULL, &status);
+        }
+        fits_update_key(fptr, TINT, "FRAMENUM", &frame, "rv_fe55sim frame number", &status);
+        fits_write_img(fptr, TUSHORT, 1, pixels.size(), const_cast<unsigned short *>(&pixels[0]), &status);
+    }
+
+    int cstatus = 0;
+    fits_close_file(fptr, &cstatus);
+    checkFits(status ? status : cstatus, "Writing " + fileName);
+}
+}
+
+int
+main(int argc, char **argv)
+{
+    SimConfig cfg;
+    char const *layoutName = "camera";
+    char const *output = NULL;
+    char const *truthFile = NULL;
+    int nframe = 1;
+    boost::uint64_t seed = 1;
+
+    for (int i = 1; i < argc; ++i) {
+        if (argv[i][0] != '-' || argv[i][1] == '\0' || argv[i][2] != '\0') {
+            usage();
+            return 1;
+        }
+        int const nval = (strchr("Kb", argv[i][1]) != NULL) ? 2 : 1;
+        if (i + nval >= argc) {
+            usage();
+            return 1;
+        }
+        switch (argv[i][1]) {
+          case 'l': layoutName = argv[++i]; break;
+          case 'N': nframe = atoi(argv[++i]); break;
+          case 'n': cfg.nxray = atof(argv[++i]); break;
+          case 'K': cfg.kAlpha = atof(argv[++i]); cfg.kBeta = atof(argv[++i]); break;
+          case 'k': cfg.kBetaFrac = atof(argv[++i]); break;
+          case 's': cfg.splitFrac = atof(argv[++i]); break;
+          case 'c': cfg.cornerFrac = atof(argv[++i]); break;
+          case 'r': cfg.readNoise = atof(argv[++i]); break;
+          case 'b': cfg.bias = atof(argv[++i]); cfg.biasRms = atof(argv[++i]); break;
+          case 'C': cfg.ncosmic = atof(argv[++i]); break;
+          case 'S': seed = strtoull(argv[++i], NULL, 0); break;
+          case 'T': truthFile = argv[++i]; break;
+          case 'o': output = argv[++i]; break;
+          default:
+            usage();
+            return 1;
+        }
+    }
+
+    bool const events = (strcmp(layoutName, "events") == 0);
+    bool const camera = (strcmp(layoutName, "camera") == 0);
+    if (!events && !camera && strcmp(layoutName, "medpict") != 0) {
+        (void)fprintf(stderr, "don't recognize this layout: %s\n", layoutName);
+        return 1;
+    }
+    Layout const& layout = (camera || events) ? cameraLayout : medpictLayout;
+
+    struct rv_writer truth;
+    int truthFd = -1;
+    if (truthFile) {
+        if ((truthFd = open(truthFile, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0 ||
+            rv_writer_open(&truth, truthFd) < 0) {
+            perror(truthFile);
+            return 1;
+        }
+    }
+
+    Simulator sim(cfg, layout, seed, truthFile ? &truth : NULL);
+    try {
+        if (events) {
+            int fd = 1;
+            if (output && strcmp(output, "-") != 0 &&
+                (fd = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0) {
+                perror(output);
+                return 1;
+            }
+            struct rv_writer evout;
+            if (rv_writer_open(&evout, fd) < 0) {
+                perror("rv_fe55sim");
+                return 1;
+            }
+            for (int frame = 0; frame != nframe; ++frame) {
+                sim.writeEvents(&evout, frame);
+            }
+            if (rv_writer_close(&evout) < 0 || (fd != 1 && close(fd) < 0)) {
+                perror("rv_fe55sim");
+                return 1;
+            }
+        } else {
+            for (int frame = 0; frame != nframe; ++frame) {
+                char fileName[1024];
+                snprintf(fileName, sizeof(fileName), "%s%04d.fits", (output ? output : "fe55sim-"), frame);
+                writeFrame(sim, layout, camera, frame, fileName);
+            }
+        }
+    } catch (std::runtime_error const& e) {
+        (void)fprintf(stderr, "rv_fe55sim: %s\n", e.what());
+        return 1;
+    }
+
+    if (truthFile && (rv_writer_close(&truth) < 0 || close(truthFd) < 0)) {
+        perror(truthFile);
+        return 1;
+    }
+
+    return 0;
+}
+#endif
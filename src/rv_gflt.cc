@@ -0,0 +1,151 @@
+/*
+ *  rv_gflt.cc -- a drop-in replacement for bin/rv_gflt, built on EventFilter
+ *
+ *	Accepts the same arguments as rv_gflt (event split [-g glist...] [-p phlo phhi])
+ *	and writes the same events, but applies the cuts a column at a time and does
+ *	its I/O in large blocks (see rvio.h).  It also takes ROI, frame, chip and p9 cuts.
+ */
+#if defined(MAIN)
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include "lsst/rasmussen/filter.h"
+#include "lsst/rasmussen/rvio.h"
+
+namespace {
+void
+usage()
+{
+    (void)fprintf(stderr, "Usage:  rv_gflt event split [-g glist...] [-p phlo phhi] [-x xlo xhi] [-y ylo yhi]\n");
+    (void)fprintf(stderr, "                [-f framelo framehi] [-c chiplo chiphi] [-9 p9lo p9hi] < evlist > evlist2\n\n");
+    (void)fprintf(stderr, "\tevent   == event threshold\n");
+    (void)fprintf(stderr, "\tsplit   == split threshold\n");
+    (void)fprintf(stderr, "\tglist   == list of grades to pass\n");
+    (void)fprintf(stderr, "\tphlo phhi == range of summed pha to pass (default 0 4095)\n");
+    (void)fprintf(stderr, "\txlo xhi, ylo yhi == region of interest to pass\n");
+    (void)fprintf(stderr, "\tframelo framehi, chiplo chiphi == range of frames/chips to pass\n");
+    (void)fprintf(stderr, "\tp9lo p9hi == range of p9 to pass\n");
+    (void)fprintf(stderr, "\tevlist  == rv_style event list\n");
+    (void)fprintf(stderr, "\tevlist2 == filtered rv_style event list\n");
+    (void)fprintf(stderr, "\nAll ranges are lo <= value < hi.  This version uses Dec92 exclusive grades;\n");
+    (void)fprintf(stderr, "see bin/rv_gflt for their definitions\n");
+}
+
+/*
+ * Read the pair of integers following argv[*i] into lo and hi
+ */
+bool
+getRange(int argc, char **argv, int *i, int *lo, int *hi)
+{
+    if (*i + 2 >= argc) {
+        return false;
+    }
+    *lo = atoi(argv[++*i]);
+    *hi = atoi(argv[++*i]);
+
+    return true;
+}
+}
+
+int
+main(int argc, char **argv)
+{
+    if (argc < 3) {
+        usage();
+        return 1;
+    }
+    int const event = atoi(argv[1]);
+    int const split = atoi(argv[2]);
+
+    lsst::rasmussen::EventFilter filter;
+    HistogramTable table(event, split);
+
+    int phlo = 0, phhi = 4095;
+    int grades = ~0;
+    for (int i = 3; i < argc; ++i) {
+        if (argv[i][0] != '-') {
+            continue;                   // rv_gflt ignores junk arguments too
+        }
+        int lo = 0, hi = 0;
+        switch (argv[i][1]) {
+          case 'g':
+            if (grades == ~0) grades = 0x0;
+            while (i + 1 < argc && argv[i + 1][0] != '-') {
+                int const gr = atoi(argv[++i]);
+                if (gr < 0 || gr >= HistogramTable::NGRADE) { usage(); return 1; }
+                grades |= (1 << gr);
+            }
+            break;
+          case 'p':
+            if (!getRange(argc, argv, &i, &phlo, &phhi)) { usage(); return 1; }
+            break;
+          case 'x':
+            if (!getRange(argc, argv, &i, &lo, &hi)) { usage(); return 1; }
+            filter.setXRange(lo, hi);
+            break;
+          case 'y':
+            if (!getRange(argc, argv, &i, &lo, &hi)) { usage(); return 1; }
+            filter.setYRange(lo, hi);
+            break;
+          case 'f':
+            if (!getRange(argc, argv, &i, &lo, &hi)) { usage(); return 1; }
+            filter.setFrameRange(lo, hi);
+            break;
+          case 'c':
+            if (!getRange(argc, argv, &i, &lo, &hi)) { usage(); return 1; }
+            filter.setChipRange(lo, hi);
+            break;
+          case '9':
+            if (!getRange(argc, argv, &i, &lo, &hi)) { usage(); return 1; }
+            filter.setP9Range(lo, hi);
+            table.setCalctype(HistogramTable::P_9);
+            break;
+          default:
+            break;
+        }
+    }
+    filter.setGrades(grades);
+    /*
+     * rv_gflt drops events with sum >= MAXADU before applying -p
+     */
+    filter.setPhaRange(phlo, std::min(phhi, HistogramTable::MAXADU));
+    /*
+     * Ready for the data now.  We write the input records themselves (not rebuilt data_strs), so the
+     * output is byte-for-byte what rv_gflt would have written
+     */
+    struct rv_reader evin;
+    struct rv_writer evout;
+    if (rv_reader_open(&evin, 0) < 0 || rv_writer_open(&evout, 1) < 0) {
+        perror("rv_gflt");
+        return 1;
+    }
+
+    lsst::rasmussen::EventColumns columns(evin.nevent);
+    data_str *events;
+    int num;
+    while ((num = rv_read_events(&evin, &events)) > 0) {
+        columns.clear();
+        columns.append(events, num);
+
+        ndarray::Array<int, 1, 1> const selected = filter.apply(columns, table);
+        int const nselected = selected.getSize<0>();
+        for (int i = 0; i != nselected; ++i) {
+            if (rv_write_events(&evout, &events[selected[i]], 1) < 0) {
+                perror("rv_gflt");
+                return 1;
+            }
+        }
+    }
+    if (rv_reader_error(&evin) < 0) {
+        perror("rv_gflt");
+        return 1;
+    }
+    rv_reader_close(&evin);
+    if (rv_writer_close(&evout) < 0) {
+        perror("rv_gflt");
+        return 1;
+    }
+
+    return 0;
+}
+#endif
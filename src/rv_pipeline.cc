@@ -0,0 +1,250 @@
+/*
+ *  rv_pipeline.cc -- medpict_lsst -b -e | rv_gflt | rv_ev2xygpx (or rv_ev2pcf) in one process
+ *
+ *	The event search, grade filter and classification/histogramming are stages
+ *	that share one EventColumns, so the events are never serialised through pipes
+ *	and each is classified only once (by EventFilter; the output stage uses the
+ *	grade, sum and p9 columns that it filled in).  The output is the same as the
+ *	shell pipeline's.
+ */
+#if defined(MAIN)
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include "lsst/rasmussen/filter.h"
+#include "lsst/rasmussen/search.h"
+#include "lsst/rasmussen/instrument.h"
+#include "lsst/rasmussen/trace.h"
+
+namespace {
+void
+usage()
+{
+    (void)fprintf(stderr, "Usage:  rv_pipeline event split [-g glist...] [-p phlo phhi] [-o output]\n");
+    (void)fprintf(stderr, "                    [-f format] [-c] [-t evthresh] [-R rebin] [-B biasfile]\n");
+    (void)fprintf(stderr, "                    [-I instfile] [-T tracefile] file...\n\n");
+    (void)fprintf(stderr, "\tevent   == event threshold\n");
+    (void)fprintf(stderr, "\tsplit   == split threshold\n");
+    (void)fprintf(stderr, "\tglist   == list of grades to pass (as rv_gflt -g)\n");
+    (void)fprintf(stderr, "\tphlo phhi == range of summed pha to pass (default 0 4095)\n");
+    (void)fprintf(stderr, "\toutput  == p9 | p17 | p35 | p1357 | plist (as rv_ev2xygpx), or pcf (as rv_ev2pcf);\n");
+    (void)fprintf(stderr, "\t           default p9\n");
+    (void)fprintf(stderr, "\tformat, -c, evthresh, rebin, biasfile == as medpict_lsst -b -e (default format s)\n");
+    (void)fprintf(stderr, "\tinstfile == write the time spent in each stage, and why events were rejected,\n");
+    (void)fprintf(stderr, "\t           to this file as JSON\n");
+    (void)fprintf(stderr, "\ttracefile == write a timeline of reading and searching the frames to this file\n");
+    (void)fprintf(stderr, "\t           (in the Chrome trace-event format)\n");
+    (void)fprintf(stderr, "\tfile    == the frames to search\n");
+    (void)fprintf(stderr, "\nEquivalent to\n");
+    (void)fprintf(stderr, "\tmedpict_lsst -b -e [medpict options] file... |\n");
+    (void)fprintf(stderr, "\t   rv_gflt event split [-g glist...] [-p phlo phhi] | rv_ev2xygpx event split output\n");
+}
+
+/*
+ * Is s a grade (a single digit), rather than the next option or a file name?
+ */
+bool
+isGrade(char const *s)
+{
+    return s[0] >= '0' && s[0] <= '9' && s[1] == '\0';
+}
+/*
+ * Write the selected events as rv_ev2xygpx does
+ */
+void
+writeXygpx(FILE *fd,
+           lsst::rasmussen::EventColumns & columns,
+           ndarray::Array<int, 1, 1> const& selected,
+           bool plist)
+{
+    ndarray::Array<float, 2, 2> const data = columns.getData();
+    ndarray::Array<int, 1, 1> const x = columns.getX();
+    ndarray::Array<int, 1, 1> const y = columns.getY();
+    ndarray::Array<int, 1, 1> const grade = columns.getGrade();
+    ndarray::Array<float, 1, 1> const sum = columns.getSum();
+    ndarray::Array<float, 1, 1> const p9 = columns.getP9();
+
+    int const nselected = selected.getSize<0>();
+    for (int k = 0; k != nselected; ++k) {
+        int const i = selected[k];
+        if (plist) {
+            (void)fprintf(fd, "%d %d %d %d p:", x[i], y[i], grade[i], static_cast<int>(sum[i]));
+            for (int j = 0; j != 9; ++j) {
+                (void)fprintf(fd, " %g", data[i][j]);
+            }
+            (void)fprintf(fd, "\n");
+        } else {
+            (void)fprintf(fd, "%d %d %d %d %d %d\n", x[i], y[i], grade[i], static_cast<int>(sum[i]),
+                          static_cast<int>(data[i][4]), static_cast<int>(p9[i]));
+        }
+    }
+}
+/*
+ * Histogram the selected events and write them as rv_ev2pcf does
+ */
+void
+writePcf(FILE *fd,
+         lsst::rasmussen::EventColumns & columns,
+         ndarray::Array<int, 1, 1> const& selected,
+         HistogramTable & table)
+{
+    int const nselected = selected.getSize<0>();
+    for (int k = 0; k != nselected; ++k) {
+        lsst::rasmussen::Event const ev = columns.getEvent(selected[k]);
+        (void)table.accumulate(&ev);    // already classified by the filter
+    }
+
+    table.dump_head(fd, NULL, nselected);
+    table.dump_hist(fd);
+}
+}
+
+int
+main(int argc, char **argv)
+{
+    if (argc < 4) {
+        usage();
+        return 1;
+    }
+    int const event = atoi(argv[1]);
+    int const split = atoi(argv[2]);
+
+    lsst::rasmussen::MedpictConfig config;
+    std::vector<std::string> fileNames;
+    int phlo = 0, phhi = 4095;
+    int grades = ~0;
+    char const *output = "p9";
+    char const *instFile = NULL;
+    char const *traceFile = NULL;
+    for (int i = 3; i < argc; ++i) {
+        if (argv[i][0] != '-') {
+            fileNames.push_back(argv[i]);
+            continue;
+        }
+        switch (argv[i][1]) {
+          case 'g':
+            if (grades == ~0) grades = 0x0;
+            while (i + 1 < argc && isGrade(argv[i + 1])) {
+                int const gr = atoi(argv[++i]);
+                if (gr >= HistogramTable::NGRADE) { usage(); return 1; }
+                grades |= (1 << gr);
+            }
+            break;
+          case 'p':
+            if (i + 2 >= argc) { usage(); return 1; }
+            phlo = atoi(argv[++i]);
+            phhi = atoi(argv[++i]);
+            break;
+          case 'o':
+            if (i + 1 >= argc) { usage(); return 1; }
+            output = argv[++i];
+            break;
+          case 'f':
+            if (i + 1 >= argc || strchr("csehlab", argv[i + 1][0]) == NULL) { usage(); return 1; }
+            config.format = static_cast<lsst::rasmussen::MedpictConfig::Format>(argv[++i][0]);
+            break;
+          case 'c':
+            config.ocCorrection = true;
+            break;
+          case 't':
+            if (i + 1 >= argc) { usage(); return 1; }
+            config.evthresh = static_cast<int>(atof(argv[++i]));
+            break;
+          case 'R':
+            if (i + 1 >= argc || atoi(argv[i + 1]) < 1) { usage(); return 1; }
+            config.rebin = atoi(argv[++i]);
+            break;
+          case 'B':
+            if (i + 1 >= argc) { usage(); return 1; }
+            config.biasFile = argv[++i];
+            break;
+          case 'I':
+            if (i + 1 >= argc) { usage(); return 1; }
+            instFile = argv[++i];
+            break;
+          case 'T':
+            if (i + 1 >= argc) { usage(); return 1; }
+            traceFile = argv[++i];
+            break;
+          default:
+            usage();
+            return 1;
+        }
+    }
+    if (fileNames.empty()) {
+        usage();
+        return 1;
+    }
+
+    bool pcf = false, plist = false;
+    HistogramTable table(event, split);
+    if (strcmp(output, "p9") == 0) {
+        table.setCalctype(HistogramTable::P_9);
+    } else if (strcmp(output, "p17") == 0) {
+        table.setCalctype(HistogramTable::P_17);
+    } else if (strcmp(output, "p35") == 0) {
+        table.setCalctype(HistogramTable::P_35);
+    } else if (strcmp(output, "p1357") == 0) {
+        table.setCalctype(HistogramTable::P_1357);
+    } else if (strcmp(output, "plist") == 0) {
+        plist = true;
+    } else if (strcmp(output, "pcf") == 0) {
+        pcf = true;
+    } else {
+        (void)fprintf(stderr, "don't recognize this output: %s\n", output);
+        return 1;
+    }
+
+    lsst::rasmussen::EventFilter filter;
+    filter.setGrades(grades);
+    filter.setPhaRange(phlo, std::min(phhi, HistogramTable::MAXADU)); // see rv_gflt.cc
+    /*
+     * Search, filter (classifying as we go), and write the survivors
+     */
+    if (traceFile) {
+        lsst::rasmussen::Trace::start();
+    }
+    lsst::rasmussen::EventColumns columns;
+    try {
+        lsst::rasmussen::medpictSearch(fileNames, config, columns);
+    } catch (std::runtime_error const& e) {
+        (void)fprintf(stderr, "rv_pipeline: %s\n", e.what());
+        return 1;
+    }
+
+    ndarray::Array<int, 1, 1> const selected = filter.apply(columns, table);
+
+    setvbuf(stdout, NULL, _IOFBF, 1 << 20);
+    {
+        lsst::rasmussen::Trace::Span span("write", "events");
+        if (pcf) {
+            writePcf(stdout, columns, selected, table);
+        } else {
+            writeXygpx(stdout, columns, selected, plist);
+        }
+        fflush(stdout);
+    }
+
+    if (traceFile) {
+        try {
+            lsst::rasmussen::Trace::write(traceFile);
+        } catch (std::runtime_error const& e) {
+            (void)fprintf(stderr, "rv_pipeline: %s\n", e.what());
+            return 1;
+        }
+    }
+    if (instFile) {
+        FILE *fd = fopen(instFile, "w");
+        if (fd == NULL) {
+            (void)fprintf(stderr, "rv_pipeline: unable to open %s\n", instFile);
+            return 1;
+        }
+        (void)fprintf(fd, "%s\n", lsst::rasmussen::Instrumentation::toJson().c_str());
+        fclose(fd);
+    }
+
+    return 0;
+}
+#endif
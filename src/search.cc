@@ -0,0 +1,290 @@
+/*
+ * medpict_lsst's burst-mode event search, as a library call
+ *
+ * This file is also linked into the rv_* programs, so it reports errors with std::runtime_error
+ * rather than pex exceptions
+ */
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include "fitsio.h"
+#include "lsst/rasmussen/search.h"
+#include "lsst/rasmussen/instrument.h"
+#include "lsst/rasmussen/trace.h"
+
+namespace lsst {
+namespace rasmussen {
+
+namespace {
+    /*
+     * Where a format's overclock is, and which columns it corrects.  The sampled overclock pixels of
+     * region oc are columns ocsample0 + stride*oc + [0, nocpix), and the pixels that it corrects are
+     * occ0 + stride*oc + [0, ncor).  Only rows [0, nysample) are used to measure the overclock level
+     */
+    struct FormatInfo {
+        int noc, nocpix, ncor, nysample, ocsample0, occ0, stride;
+    };
+
+    FormatInfo
+    getFormatInfo(MedpictConfig::Format format)
+    {
+        FormatInfo const astd =     { 1, 553 - 517 + 1, 512,       100,  516,      4, 340 };
+        FormatInfo const lbox =     { 4, 337 - 261 + 1, 256,       100,  260,      4, 340 };
+        FormatInfo const hirefs =   { 2, 337 - 261 + 1, 256,       100,  260,      4, 340 };
+        FormatInfo const berlin =   { 4, 276 - 261 + 1, 256,       100,  260,      4, 280 };
+        FormatInfo const bnl_e2v =  { 1, 2024 - 2009 + 1, 2008,    100,  2008,     0, 2048 };
+        FormatInfo const ccd250 =   { 1, 542 - (512 + 10) + 1, 512 + 10, 2002, 512 + 10, 0, 2048 };
+        FormatInfo const lsst_sta = { 1, 529 - 510 + 1, 509,       1999, 509,      0, 2048 };
+
+        switch (format) {
+          case MedpictConfig::ASTD:     return astd;
+          case MedpictConfig::LBOX:     return lbox;
+          case MedpictConfig::HIREFS:   return hirefs;
+          case MedpictConfig::BERLIN:   return berlin;
+          case MedpictConfig::BNL_E2V:  return bnl_e2v;
+          case MedpictConfig::E2V_CCD250: return ccd250;
+          case MedpictConfig::LSST_STA: return lsst_sta;
+        }
+        throw std::runtime_error("Unknown medpict format");
+    }
+
+    void
+    checkFits(int status, std::string const& what)
+    {
+        if (status != 0) {
+            char msg[FLEN_STATUS];
+            fits_get_errstatus(status, msg);
+            throw std::runtime_error(what + ": " + msg);
+        }
+    }
+    /*
+     * Read the whole of a frame;  all frames must be nx*ny
+     */
+    void
+    readFrame(std::string const& fileName, int *nx, int *ny, std::vector<int> & pixels)
+    {
+        Trace::Span span("readFrame", "frame");
+        span.addArg("file", fileName);
+
+        int status = 0;
+        fitsfile *fptr = NULL;
+        fits_open_file(&fptr, fileName.c_str(), READONLY, &status);
+        checkFits(status, "Opening " + fileName);
+
+        long naxis[2] = { 0, 0 };
+        fits_get_img_size(fptr, 2, naxis, &status);
+        if (status == 0) {
+            if (*nx < 0) {
+                *nx = naxis[0];
+                *ny = naxis[1];
+            } else if (naxis[0] != *nx || naxis[1] != *ny) {
+                fits_close_file(fptr, &status);
+                throw std::runtime_error("Mis-matching header parameters in " + fileName);
+            }
+            pixels.resize(static_cast<size_t>(*nx)*(*ny));
+
+            long fpixel[2] = { 1L, 1L };
+            fits_read_pix(fptr, TINT, fpixel, pixels.size(), NULL, &pixels[0], NULL, &status);
+        }
+        int cstatus = 0;
+        fits_close_file(fptr, &cstatus);
+        checkFits(status, "Reading " + fileName);
+    }
+    /*
+     * The mean overclock level of each overclock region, as medpict's evaluate_OC_vals() measures it:  a
+     * histogram of the sampled pixels within OCHISTOS of the mean of row 50, and the mean of that histogram
+     */
+    void
+    evaluateOC(std::vector<int> const& dp, int nx, FormatInfo const& fmt, std::vector<float> & ocval)
+    {
+        int const OCHISTMAX = 300, OCHISTOS = 150;
+
+        ocval.resize(fmt.noc);
+        for (int oc = 0; oc != fmt.noc; ++oc) {
+            int const x0 = fmt.ocsample0 + fmt.stride*oc;
+
+            int psum = 0, nsum = 0;
+            for (int xi = 0; xi != fmt.nocpix; ++xi) {
+                psum += dp[50*nx + x0 + xi];
+                nsum++;
+            }
+            int const min = static_cast<int>(std::floor(psum/(1.0*nsum)) - OCHISTOS);
+
+            int ochist[OCHISTMAX];
+            std::fill(ochist, ochist + OCHISTMAX, 0);
+            for (int y = 0; y != fmt.nysample; ++y) {
+                for (int xi = 0; xi != fmt.nocpix; ++xi) {
+                    int const val = dp[y*nx + x0 + xi] - min;
+                    if (val >= 0 && val < OCHISTMAX) {
+                        ochist[val]++;
+                    }
+                }
+            }
+
+            psum = 0; nsum = 0;
+            for (int i = 0; i != OCHISTMAX; ++i) {
+                psum += (i + min)*ochist[i];
+                nsum += ochist[i];
+            }
+            ocval[oc] = psum/(1.0*nsum);
+        }
+    }
+    /*
+     * medpict's median().  For odd n this is the element above the median, and for even n the mean of
+     * the middle element and the one above it (for n == 2 medpict reads past the end of the array; we
+     * use the larger element instead)
+     */
+    int
+    medpictMedian(std::vector<int> & x)
+    {
+        int const n = x.size();
+        if (n == 1) {
+            return x[0];
+        }
+
+        int const n2 = n/2;
+        int const n2p = std::min(n2 + 1, n - 1);
+        std::nth_element(x.begin(), x.begin() + n2p, x.end());
+        if (n%2 == 1) {
+            return x[n2p];
+        }
+        int const below = (n2 == n2p) ? x[n2] : *std::max_element(x.begin(), x.begin() + n2p);
+        return static_cast<int>(std::floor(0.5*(below + x[n2p])));
+    }
+}
+
+void
+medpictSearch(std::vector<std::string> const& fileNames,
+              MedpictConfig const& config,
+              EventColumns & events)
+{
+    int const fni = fileNames.size();
+    if (fni == 0) {
+        return;
+    }
+    FormatInfo const fmt = getFormatInfo(config.format);
+    Trace::Span span("medpictSearch", "file");
+    span.addArg("nframe", fni);
+    /*
+     * Slurp in the files
+     */
+    int nx = -1, ny = -1;
+    std::vector<std::vector<int> > dp(fni);
+    std::vector<int> bias;
+    {
+        LSST_RASMUSSEN_TIMER(timer, READ);
+        LSST_RASMUSSEN_TIMER_EVENTS(timer, fni);
+        for (int fi = 0; fi != fni; ++fi) {
+            readFrame(fileNames[fi], &nx, &ny, dp[fi]);
+        }
+        if (config.biasFile != "") {
+            readFrame(config.biasFile, &nx, &ny, bias);
+        }
+    }
+    LSST_RASMUSSEN_TIMER(timer, DETECT);
+    int const npix = nx*ny;
+    /*
+     * Which overclock corrects each column (+1;  0 means that the column isn't part of the imaging area)
+     */
+    std::vector<char> occLU(std::max(nx, 2048), 0);
+    for (int oc = 0; oc != fmt.noc; ++oc) {
+        for (int xi = 0; xi != fmt.ncor; ++xi) {
+            occLU[fmt.occ0 + fmt.stride*oc + xi] = oc + 1;
+        }
+    }
+    /*
+     * Correct for the overclock, and subtract the bias
+     */
+    std::vector<std::vector<int> > ocInt(fni, std::vector<int>(fmt.noc, 0));
+    if (config.ocCorrection) {
+        std::vector<float> ocval;
+        for (int fi = 0; fi != fni; ++fi) {
+            evaluateOC(dp[fi], nx, fmt, ocval);
+            for (int oc = 0; oc != fmt.noc; ++oc) {
+                ocInt[fi][oc] = static_cast<int>(std::floor(ocval[oc] + 0.5));
+            }
+        }
+    }
+
+    std::vector<int> pix(fni);
+    for (int i = 0; i != npix; ++i) {
+        int const oc = occLU[i%nx];
+        if (!oc) {
+            continue;
+        }
+        for (int fi = 0; fi != fni; ++fi) {
+            dp[fi][i] -= ocInt[fi][oc - 1];
+        }
+        if (!bias.empty()) {
+            for (int fi = 0; fi != fni; ++fi) {
+                dp[fi][i] -= bias[i];
+            }
+        } else if (fni > 1) {           // the median of one frame is the frame; don't subtract it
+            for (int fi = 0; fi != fni; ++fi) {
+                pix[fi] = dp[fi][i];
+            }
+            int const med = medpictMedian(pix);
+            for (int fi = 0; fi != fni; ++fi) {
+                dp[fi][i] -= med;
+            }
+        }
+    }
+    /*
+     * Look for events, local maxima in the (rebinned) imaging area.  medpict pushes each frame's
+     * events onto a stack, so it writes them in the reverse of the order that it finds them
+     */
+    int const reb = config.rebin;
+    int const rnx = std::ceil(nx/static_cast<float>(reb));
+    int const rny = std::ceil(ny/static_cast<float>(reb));
+    std::vector<int> rebinned(rnx*rny);
+    std::vector<data_str> found;
+
+    data_str event;
+    memset(&event, '\0', sizeof(event));
+    event.chipnum = 0;
+
+    for (int fi = 0; fi != fni; ++fi) {
+        Trace::Span span("search", "frame");
+        span.addArg("frame", fi);
+
+        std::fill(rebinned.begin(), rebinned.end(), 0);
+        for (int j = 0; j != ny; ++j) {
+            for (int k = 0; k != nx; ++k) {
+                if (occLU[k]) {
+                    rebinned[k/reb + (j/reb)*rnx] += dp[fi][k + j*nx];
+                }
+            }
+        }
+
+        found.clear();
+        event.framenum = fi;
+        for (int j = 1; j < rny - 1; ++j) {
+            for (int k = 1; k < rnx - 1; ++k) {
+                int const *cpix = &rebinned[k + j*rnx];
+                if (*cpix < config.evthresh) continue;
+                if (*cpix >= *(cpix+rnx)   &&     *cpix >= *(cpix+1)     &&
+                    *cpix >  *(cpix-1)     &&     *cpix >  *(cpix-rnx)   &&
+                    *cpix >= *(cpix+rnx+1) &&     *cpix >= *(cpix+rnx-1) &&
+                    *cpix >  *(cpix-rnx+1) &&     *cpix >  *(cpix-rnx-1)) {
+                    event.x = k;
+                    event.y = j;
+                    for (int yi = -1; yi <= 1; ++yi) {
+                        for (int xi = -1; xi <= 1; ++xi) {
+                            event.data[xi + 1 + (yi + 1)*3] = *(cpix + yi*rnx + xi);
+                        }
+                    }
+                    found.push_back(event);
+                }
+            }
+        }
+
+        LSST_RASMUSSEN_TIMER_EVENTS(timer, found.size());
+        events.reserve(events.size() + found.size());
+        for (std::vector<data_str>::const_reverse_iterator ptr = found.rbegin(); ptr != found.rend(); ++ptr) {
+            events.push_back(*ptr);
+        }
+    }
+}
+
+}}
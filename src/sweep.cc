@@ -0,0 +1,158 @@
+/*
+ * Fill a bank of HistogramTables covering a grid of event/split thresholds and calctypes
+ */
+#include <cstring>
+#include <algorithm>
+#include "boost/format.hpp"
+#include "lsst/pex/exceptions.h"
+#include "lsst/rasmussen/sweep.h"
+#include "lsst/rasmussen/instrument.h"
+
+namespace lsst {
+namespace rasmussen {
+
+HistogramBank::HistogramBank(std::vector<int> const& events,
+                             std::vector<int> const& splits,
+                             std::vector<HistogramTable::calctype> const& calctypes
+                            ) :
+    _minEvent(events.empty() ? 0 : *std::min_element(events.begin(), events.end()))
+{
+    for (std::vector<int>::const_iterator eptr = events.begin(); eptr != events.end(); ++eptr) {
+        for (unsigned int s = 0; s != splits.size(); ++s) {
+            for (unsigned int c = 0; c != calctypes.size(); ++c) {
+                Point point;
+                point.event = *eptr;
+                point.split = splits[s];
+                point.calctype = calctypes[c];
+                point.classifier = s*calctypes.size() + c;
+
+                _grid.push_back(point);
+                _tables.push_back(boost::shared_ptr<HistogramTable>(
+                                      new HistogramTable(point.event, point.split, HistogramTable::TNONE, 0.0,
+                                                         ~0, point.calctype)));
+            }
+        }
+    }
+    /*
+     * The classifiers have an event threshold of 0;  we only use them to classify
+     */
+    data_str ds;
+    memset(&ds, '\0', sizeof(ds));
+    for (unsigned int s = 0; s != splits.size(); ++s) {
+        for (unsigned int c = 0; c != calctypes.size(); ++c) {
+            _classifiers.push_back(HistogramTable(0, splits[s], HistogramTable::TNONE, 0.0, ~0, calctypes[c]));
+            _scratch.push_back(Event(ds));
+        }
+    }
+}
+
+boost::shared_ptr<HistogramTable>
+HistogramBank::getTable(int i) const
+{
+    if (i < 0 || i >= size()) {
+        throw LSST_EXCEPT(lsst::pex::exceptions::OutOfRangeException,
+                          str(boost::format("Index %d is out of range 0..%d") % i % (size() - 1)));
+    }
+    return _tables[i];
+}
+
+boost::shared_ptr<HistogramTable>
+HistogramBank::getTable(int event, int split, HistogramTable::calctype calctype) const
+{
+    for (int i = 0; i != size(); ++i) {
+        if (_grid[i].event == event && _grid[i].split == split && _grid[i].calctype == calctype) {
+            return _tables[i];
+        }
+    }
+    throw LSST_EXCEPT(lsst::pex::exceptions::NotFoundException,
+                      str(boost::format("No table for event %d split %d calctype %d") % event % split % calctype));
+}
+
+int HistogramBank::getEventThreshold(int i) const { return getTable(i)->getEventThreshold(); }
+int HistogramBank::getSplitThreshold(int i) const { (void)getTable(i); return _grid[i].split; }
+HistogramTable::calctype HistogramBank::getCalctype(int i) const { (void)getTable(i); return _grid[i].calctype; }
+
+void
+HistogramBank::setFilter(int filter)
+{
+    for (int i = 0; i != size(); ++i) {
+        _tables[i]->setFilter(filter);
+    }
+}
+
+void
+HistogramBank::setReset(HistogramTable::RESET_STYLES sty, double rst)
+{
+    for (int i = 0; i != size(); ++i) {
+        _tables[i]->setReset(sty, rst);
+    }
+    for (unsigned int c = 0; c != _classifiers.size(); ++c) {
+        _classifiers[c].setReset(sty, rst);
+    }
+}
+
+void
+HistogramBank::setPixelType(HistogramTable::pixeltype pixelType)
+{
+    for (int i = 0; i != size(); ++i) {
+        _tables[i]->setPixelType(pixelType);
+    }
+    for (unsigned int c = 0; c != _classifiers.size(); ++c) {
+        _classifiers[c].setPixelType(pixelType);
+    }
+}
+
+void
+HistogramBank::setSaturation(double saturation)
+{
+    for (int i = 0; i != size(); ++i) {
+        _tables[i]->setSaturation(saturation);
+    }
+    for (unsigned int c = 0; c != _classifiers.size(); ++c) {
+        _classifiers[c].setSaturation(saturation);
+    }
+}
+
+/*
+ * Classify one event with each classifier (unless no table will want it), then give the results to
+ * all the tables
+ */
+void
+HistogramBank::_process(data_str const& ds, int flags)
+{
+    for (unsigned int c = 0; c != _classifiers.size(); ++c) {
+        Event & ev = _scratch[c];
+        static_cast<data_str &>(ev) = ds;
+        ev.invalidateClassification();
+        ev.grade = Event::UNKNOWN;
+        ev.flags = flags & Event::EDGE; // set when the event was extracted;  classify() sets the rest
+        if (ds.data[4] >= _minEvent) {
+            _classifiers[c].classify(&ev);
+        }
+    }
+
+    for (int i = 0; i != size(); ++i) {
+        (void)_tables[i]->accumulate(&_scratch[_grid[i].classifier]);
+    }
+}
+
+void
+HistogramBank::process(EventColumns const& events)
+{
+    LSST_RASMUSSEN_TIMER(timer, HISTOGRAM);
+    ndarray::Array<int, 1, 1> const flags = events.getFlags();
+    for (int i = 0; i != events.size(); ++i) {
+        _process(events.getDataStr(i), flags[i]);
+    }
+}
+
+void
+HistogramBank::process(std::vector<boost::shared_ptr<Event> > const& events)
+{
+    LSST_RASMUSSEN_TIMER(timer, HISTOGRAM);
+    for (std::vector<boost::shared_ptr<Event> >::const_iterator ptr = events.begin(); ptr != events.end(); ++ptr) {
+        _process(**ptr, (*ptr)->flags);
+    }
+}
+
+}}
@@ -14,57 +14,30 @@
  */
 #include <limits>
 #include <algorithm>
+#include <stdexcept>
+#include "boost/format.hpp"
 #include "lsst/rasmussen/tables.h"
+#include "lsst/rasmussen/grades.h"
+#include "lsst/rasmussen/instrument.h"
 
 /*
- *  Initialize the histogram tables.  Each entry of the table needs
- *  to know which counter to increment, which histogram to increment
- *  and which extra pixels should be included in the summed pha,
- *  which only occurs for the L, Q and Other grades.
+ *  Initialize the histogram tables.  The mapping from an event's map to
+ *  its grade, and to the extra pixels that should be included in the
+ *  summed pha (which only occurs for the L, Q and Other grades) is
+ *  the compile-time table in grades.h, so all we need to do is to zero
+ *  the counters and histograms
  */
 HistogramTable::HistogramTable(int event, int split,
                                        RESET_STYLES sty, double rst, const int filter,
                                        calctype do_what) :
-    histo(ndarray::allocate(ndarray::makeVector(8, MAXADU))),
-    _event(event), _split(split), _filter(filter), _do_what(do_what), _efile(""), _sty(sty), _rst(rst)
+    histo(ndarray::allocate(ndarray::makeVector(static_cast<int>(NGRADE), MAXADU))),
+    _event(event), _split(split), _filter(filter), _do_what(do_what), _pixelType(SHORT),
+    _saturation(std::numeric_limits<double>::infinity()), _efile(""), _sty(sty), _rst(rst)
 {
-    static
-    const int extra[][4] = {  {4,4,4,4},
-                              {0,4,4,4}, {2,4,4,4}, {6,4,4,4}, {8,4,4,4},
-                              {0,2,4,4}, {0,6,4,4}, {6,8,4,4}, {8,2,4,4},
-                              {0,2,6,8} };
-    static
-    const unsigned char emask[] = { 0x00,
-                                    0x0a,0x12,0x48,0x50,
-                                    0x1a,0x4a,0x58,0x52,
-                                    0x5a };
-    const unsigned char sngle[] = { 0x00 };					/* 0 */
-    const unsigned char splus[] = { 0x01,0x04,0x20,0x80,0x05,0x21,0x81,		/* 1 */
-				    0x24,0x84,0xa0,0x25,0x85,0xa4,0xa1,0xa5 };
-    const unsigned char pvert[] = { 0x02,0x40,0x22,0x82,0x41,0x44,0x45,0xa2 };	/* 2 */
-    const unsigned char pleft[] = { 0x08,0x0c,0x88,0x8c };			/* 3 */
-    const unsigned char prght[] = { 0x10,0x30,0x11,0x31 };			/* 4 */
-/*
- *  const unsigned char phorz[] = { 0x08,0x10,0x0c,0x88,0x30,0x11,0x8c,0x31 };
- */
-    const unsigned char pplus[] = { 0x03,0x06,0x09,0x28,0x60,0xc0,0x90,0x14,	/* 5 */
-				    0x83,0x26,0x89,0x2c,0x64,0xc1,0x91,0x34,
-				    0x23,0x86,0x0d,0xa8,0x61,0xc4,0xb0,0x15,
-				    0xa3,0xa6,0x8d,0xac,0x65,0xc5,0xb1,0x35 };
-/*
- *  const unsigned char elish[] = { 0x12,0x32,0x50,0x51,0x48,0x4c,0x0a,0x8a };
- *  const unsigned char squar[] = { 0x16,0xd0,0x68,0x0b,0x36,0xd1,0x6c,0x8b };
- */
-    const unsigned char elnsq[] = { 0x12,0x32,0x50,0x51,0x48,0x4c,0x0a,0x8a,	/* 6 */
-				    0x16,0xd0,0x68,0x0b,0x36,0xd1,0x6c,0x8b };
-
-#if 0							  // not actually needed as an array
-    const unsigned char other[NMAP] = { all of the rest };			/* 7 */
-#endif
-
     /* initialize everything in sight */
-    nsngle = nsplus = npvert = npleft = nprght = npplus =
-        nelnsq = nother = ntotal = noobnd = nbevth = 0;
+    std::fill(counts, counts + NGRADE, 0);
+    ntotal = noobnd = nbevth = 0;
+    nsatur = 0;
 
     ev_min = MAXADU; xav = 0; yav = 0;
     min_adu = MAXADU; max_adu = 0;
@@ -72,96 +45,7 @@ HistogramTable::HistogramTable(int event, int split,
     xn = yn = std::numeric_limits<int>::max();
     xx = yx = 0;
 
-    std::fill(&histo[0][0], &histo[0][0] + 8*MAXADU, 0);
-
-    /* load the sngle events into table GRADE 0 */
-    for (int i = 0; i < sizeof(sngle); i++) {
-        look_up *t = table + sngle[i];
-        t->grade = lsst::rasmussen::Event::SINGLE;
-        t->type = &nsngle;
-        t->hist = histo[0];
-        t->extr = extra[0];	
-    }
-
-    /* load the splus events into table GRADE 1 */
-    for (int i = 0; i < sizeof(splus); i++) {
-        look_up *t = table + splus[i];
-        t->grade = lsst::rasmussen::Event::SINGLE_P_CORNER;
-        t->type = &nsplus;
-        t->hist = histo[1];
-        t->extr = extra[0];	
-    }
-
-    /* load the pvert events into table GRADE 2 */
-    for (int i = 0; i < sizeof(pvert); i++) {
-        look_up *t = table + pvert[i];
-        t->grade = lsst::rasmussen::Event::VERTICAL_SPLIT;
-        t->type = &npvert;
-        t->hist = histo[2];
-        t->extr = extra[0];	
-    }
-
-    /* load the pleft events into table GRADE 3 */
-    for (int i = 0; i < sizeof(pleft); i++) {
-        look_up *t = table + pleft[i];
-        t->grade = lsst::rasmussen::Event::LEFT_SPLIT;
-        t->type = &npleft;
-        t->hist = histo[3];
-        t->extr = extra[0];	
-    }
-
-    /* load the prght events into table GRADE 4 */
-    for (int i = 0; i < sizeof(prght); i++) {
-        look_up *t = table + prght[i];
-        t->grade = lsst::rasmussen::Event::RIGHT_SPLIT;
-        t->type = &nprght;
-        t->hist = histo[4];
-        t->extr = extra[0];	
-    }
-
-    /* load the pplus events into table GRADE 5 */
-    for (int i = 0; i < sizeof(pplus); i++) {
-        look_up *t = table + pplus[i];
-        t->grade = lsst::rasmussen::Event::SINGLE_SIDED_P_CORNER;
-        t->type = &npplus;
-        t->hist = histo[5];
-        t->extr = extra[0];	
-    }
-
-    /* load the elnsq events into table GRADE 6 */
-    for (int i = 0; i < sizeof(elnsq); i++) {
-        look_up *t = table + elnsq[i];
-        t->grade = lsst::rasmussen::Event::ELL_SQUARE_P_CORNER;
-        t->type = &nelnsq;
-        t->hist = histo[6];
-        t->extr = extra[0];	
-        for (int b = (0x5a & elnsq[i]), j = 0; j < sizeof(emask); j++)
-            if (b == emask[j]) {
-                t->extr = extra[j];
-                break;
-            }
-    }
-
-    /* load the other events into table GRADE 7 */
-    for (int i = 0; i < NMAP; i++) {
-        look_up *t = table + i;
-        if (t->type) continue;		/* already loaded */
-        t->grade = lsst::rasmussen::Event::OTHER;
-        t->type = &nother;
-        t->hist = histo[7];
-        t->extr = extra[0];	
-        /*
-         *  In this version, included corners are
-         *  ignored in all of the grade 7 events.
-         *
-         for (b = 0x5a & (unsigned char)i, j = 0;
-         j < sizeof(emask); j++)
-         if (b == emask[j]) {
-         t->extr = extra[j];
-         break;
-         }
-        */
-    }
+    std::fill(&histo[0][0], &histo[0][0] + NGRADE*MAXADU, 0);
 }
 
 const int HistogramTable::MAXADU = 4096;
@@ -169,8 +53,9 @@ const int HistogramTable::MAXADU = 4096;
 /*
  *  Insert the reset clock correction
  */
+template<typename PixelT>
 void
-HistogramTable::applyResetClockCorrection(short phe[9]) const
+HistogramTable::applyResetClockCorrection(PixelT phe[9]) const
 {
     switch (_sty) {
       case T6:
@@ -196,30 +81,69 @@ bool
 HistogramTable::process_event(lsst::rasmussen::Event *ev
                                  )
 {
+    /*
+     * Classify the event (if it's above threshold), setting its grade etc.
+     */
+    if (ev->data[4] >= _event) {
+        classify(ev);
+    } else if (ev->classifiedBy != getClassificationKey()) { // keep a classification that we could reuse
+        ev->invalidateClassification();
+        ev->grade = lsst::rasmussen::Event::UNKNOWN; // We don't know map yet.
+    }
+
+    return accumulate(ev);
+}
+
+/*
+ *  Add an event that's already been through classify() to the tables, if it's above the event
+ *  threshold, passes the grade filter, and isn't SATURATED or OVERFLOWED.  Used by process_event,
+ *  and by callers that have already classified the event and don't want to do it again
+ */
+bool
+HistogramTable::accumulate(lsst::rasmussen::Event const* ev)
+{
+    LSST_RASMUSSEN_COUNT(HISTOGRAM, 1);
     /*
      *  Get some gross event parameters
      */
     if (ev->data[4] < ev_min) ev_min = ev->data[4];
     if (ev->data[4] < _event) {
         nbevth++;
-        ev->grade = lsst::rasmussen::Event::UNKNOWN; // We don't know map yet.
+        LSST_RASMUSSEN_REJECT(BELOW_THRESHOLD, 1);
         return false;
     }
-    /*
-     * Classify that event, setting its grade etc.
-     */
-    const int map = classify(ev);
     /* 
      *  grade is identified. check with _filter to see whether  to pass it on or not.
      */
-    if (ev->grade == lsst::rasmussen::Event::UNKNOWN ||
-        ((1 << static_cast<int>(ev->grade)) & _filter) == 0x0) {
+    if (ev->grade == lsst::rasmussen::Event::UNKNOWN) {
+        LSST_RASMUSSEN_REJECT(UNGRADED, 1);
+        return false;
+    }
+    if (((1 << static_cast<int>(ev->grade)) & _filter) == 0x0) {
+        LSST_RASMUSSEN_REJECT(GRADE_FILTER, 1);
+        return false;
+    }
+    /*
+     * Don't let events that are missing pixels, saturated pixels, or pixels that wrapped when they were
+     * classified into the histograms
+     */
+    if (ev->flags & lsst::rasmussen::Event::EDGE) {
+        LSST_RASMUSSEN_REJECT(EDGE, 1);
+        return false;
+    }
+    if (ev->flags & (lsst::rasmussen::Event::SATURATED | lsst::rasmussen::Event::OVERFLOWED)) {
+        nsatur++;
+        LSST_RASMUSSEN_REJECT(SATURATED, 1);
         return false;
     }
     /*
      *  Accumulate statistics and various bounds
      */
-    if (ev->sum >= MAXADU) { noobnd++;  return false; }
+    if (ev->sum >= MAXADU) {
+        noobnd++;
+        LSST_RASMUSSEN_REJECT(OUT_OF_BOUNDS, 1);
+        return false;
+    }
     if (ev->sum > max_adu) max_adu = ev->sum;
     if (ev->sum < min_adu) min_adu = ev->sum;
     if (ev->x < xn) xn = ev->x;
@@ -229,9 +153,9 @@ HistogramTable::process_event(lsst::rasmussen::Event *ev
     xav += ev->x;
     yav += ev->y;
     ntotal++;
-    look_up *const ent = &table[map];
-    *ent->type += 1;
-    const int hsum = ent->hist[static_cast<int>(ev->sum)]++;
+    const int grade = ev->grade;
+    counts[grade]++;
+    const int hsum = ++histo[grade][static_cast<int>(ev->sum)];
     if (hsum > 2) {
         if (ev->sum > max_2ct) max_2ct = ev->sum;
         if (ev->sum < min_2ct) min_2ct = ev->sum;
@@ -240,12 +164,165 @@ HistogramTable::process_event(lsst::rasmussen::Event *ev
     return true;
 }
 
+/*
+ *  Count a column of grades.  This is a histogram of small integers, so we keep four
+ *  interleaved sets of counters (so consecutive increments don't have to wait for each
+ *  other) and an extra bin (NGRADE) to absorb out-of-range grades without a branch
+ */
+void
+HistogramTable::countGrades(ndarray::Array<int const, 1, 1> const& grades)
+{
+    enum { NSUB = 4 };
+    int sub[NSUB][NGRADE + 1];
+    std::fill(&sub[0][0], &sub[0][0] + NSUB*(NGRADE + 1), 0);
+
+#define BIN(G) (static_cast<unsigned int>(G) < NGRADE ? (G) : NGRADE)
+    int const *ptr = grades.getData();
+    int const n = grades.getSize<0>();
+    int i = 0;
+    for (; i + NSUB <= n; i += NSUB) {
+        sub[0][BIN(ptr[i    ])]++;
+        sub[1][BIN(ptr[i + 1])]++;
+        sub[2][BIN(ptr[i + 2])]++;
+        sub[3][BIN(ptr[i + 3])]++;
+    }
+    for (; i < n; ++i) {
+        sub[0][BIN(ptr[i])]++;
+    }
+#undef BIN
+
+    for (int g = 0; g != NGRADE; ++g) {
+        int const ng = sub[0][g] + sub[1][g] + sub[2][g] + sub[3][g];
+        counts[g] += ng;
+        ntotal += ng;
+    }
+    LSST_RASMUSSEN_COUNT(HISTOGRAM, n);
+}
+
+/*
+ *  Merge another table's statistics into ours.  min_2ct and max_2ct are the lowest and
+ *  highest bins holding more than two events of some grade, so they're recalculated from
+ *  the merged histograms rather than combined
+ */
+void
+HistogramTable::merge(HistogramTable const& other)
+{
+    if (other._event != _event || other._split != _split) {
+        throw std::runtime_error(str(boost::format("Can't merge a table with event, split = %d, %d "
+                                                   "into one with %d, %d")
+                                     % other._event % other._split % _event % _split));
+    }
+
+    for (int g = 0; g != NGRADE; ++g) {
+        counts[g] += other.counts[g];
+    }
+    ntotal += other.ntotal;
+    noobnd += other.noobnd;
+    nbevth += other.nbevth;
+    nsatur += other.nsatur;
+
+    ev_min = std::min(ev_min, other.ev_min);
+    xav += other.xav;
+    yav += other.yav;
+    min_adu = std::min(min_adu, other.min_adu);
+    max_adu = std::max(max_adu, other.max_adu);
+    xn = std::min(xn, other.xn);
+    xx = std::max(xx, other.xx);
+    yn = std::min(yn, other.yn);
+    yx = std::max(yx, other.yx);
+
+    for (int g = 0; g != NGRADE; ++g) {
+        int *h = &histo[g][0];
+        int const *oh = &other.histo[g][0];
+        for (int i = 0; i != MAXADU; ++i) {
+            h[i] += oh[i];
+            if (h[i] > 2) {
+                if (i > max_2ct) max_2ct = i;
+                if (i < min_2ct) min_2ct = i;
+            }
+        }
+    }
+}
+
+lsst::rasmussen::ClassificationKey
+HistogramTable::getClassificationKey() const
+{
+    lsst::rasmussen::ClassificationKey key;
+    key.split = _split;
+    key.resetStyle = _sty;
+    key.resetCoeff = _rst;
+    key.calctype = _do_what;
+    key.pixelType = _pixelType;
+    key.saturation = _saturation;
+
+    return key;
+}
+
 int
 HistogramTable::classify(lsst::rasmussen::Event *ev) const
 {
+    lsst::rasmussen::ClassificationKey const key = getClassificationKey();
+    if (ev->classifiedBy == key) {
+        return ev->map;
+    }
+    LSST_RASMUSSEN_COUNT(CLASSIFY, 1);
+
+    switch (_pixelType) {
+      case INT:
+        ev->map = _classify<int>(ev);
+        break;
+      case FLOAT:
+        ev->map = _classify<float>(ev);
+        break;
+      case SHORT:
+        ev->map = _classify<short>(ev);
+        break;
+    }
+    ev->classifiedBy = key;
+
+    return ev->map;
+}
+
+/*
+ * Do the work of classify(), with the pixel values converted to PixelT
+ *
+ * Pixels that are saturated, or that can't be represented as a PixelT (and would wrap) are
+ * reported in ev->flags;  so are NaNs, which are classified as 0
+ */
+template<typename PixelT>
+int
+HistogramTable::_classify(lsst::rasmussen::Event *ev) const
+{
+    float lo = std::numeric_limits<float>::max(), hi = -lo;
+    bool haveNaN = false;               // NaN fails every comparison, so lo and hi can't catch it
+    for (int j = 0; j < 9; j++) {
+        const float val = ev->data[j];
+        haveNaN |= !(val == val);
+        if (val < lo) lo = val;
+        if (val > hi) hi = val;
+    }
 
-    short phe[9];
-    std::copy(ev->data, ev->data + 9, phe);
+    const double pixMax = std::numeric_limits<PixelT>::max(); // exact, unlike float for int
+    ev->flags &= lsst::rasmussen::Event::EDGE; // set when the event was extracted, not by classification
+    if (hi >= _saturation) {
+        ev->flags |= lsst::rasmussen::Event::SATURATED;
+    }
+    /*
+     * Converting a float that's out of range (or NaN) to an integral PixelT is undefined, so clamp such
+     * pixels (and zero NaNs)
+     */
+    PixelT phe[9];
+    if (haveNaN || hi > pixMax || -lo > pixMax) {
+        ev->flags |= lsst::rasmussen::Event::OVERFLOWED;
+        for (int j = 0; j < 9; j++) {
+            const double val = ev->data[j];
+            phe[j] = (val == val) ? static_cast<PixelT>(std::max(-pixMax, std::min(val, pixMax))) : 0;
+        }
+    } else {
+        for (int j = 0; j < 9; j++) {
+            phe[j] = ev->data[j];
+        }
+    }
 
     applyResetClockCorrection(phe);
     /*
@@ -256,7 +333,7 @@ HistogramTable::classify(lsst::rasmussen::Event *ev) const
     ev->p9 = 0;
     ev->sum = 0;
     for (int j = 0; j < 9; j++) {
-        const short phj = phe[j];
+        const PixelT phj = phe[j];
 
         switch (_do_what) {
           case P_9:
@@ -291,13 +368,16 @@ HistogramTable::classify(lsst::rasmussen::Event *ev) const
           case 8: map |= 0x80;               ; break;
         }
     }
-    ev->grade = table[map].grade;
+    ev->grade = static_cast<lsst::rasmussen::Event::Grade>(rv_grades[map].grade);
     /*
      *  Finish pha with extra pixels of L, Q, and O events
      */
-    const look_up *const ent = &table[map];
-    const int *xtr = ent->extr;
-    for (int j = 0; xtr[j] != 4 && j < 4; j++) ev->sum += phe[xtr[j]];
+    const unsigned char xtr = rv_grades[map].extra;
+    if (xtr) {
+        for (int j = 0; j < 4; j++) {
+            if (xtr & rv_corner_bit[j]) ev->sum += phe[rv_corner_pixel[j]];
+        }
+    }
 
     return map;
 }
@@ -309,7 +389,7 @@ void
 HistogramTable::dump_table() const
 {
     for (int i = 0; i != NMAP; ++i) {
-        (void)fprintf(stderr, "%d,", table[i].grade);
+        (void)fprintf(stderr, "%d,", rv_grades[i].grade);
         if (i%16 == 15) (void)fprintf(stderr, "\n");
     }
 }
@@ -419,7 +499,7 @@ HistogramTable::dump_hist(FILE *fd,
     (void)fprintf(fd, "!\n");
     (void)fprintf(fd, "!  PHA\tS\tS+\tPv\tPl\tPr\tP+\tL+Q\tO\n");
     (void)fprintf(fd, "!  TOT\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\n",
-                  nsngle,nsplus,npvert,npleft,nprght,npplus,nelnsq,nother);
+                  counts[0], counts[1], counts[2], counts[3], counts[4], counts[5], counts[6], counts[7]);
     (void)fprintf(fd, "!\n");
 
     int tmp_min_adu = (min_adu <         EXTADU) ?      0 : min_adu - EXTADU;
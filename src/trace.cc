@@ -0,0 +1,292 @@
+/*
+ * Record spans, and write them in the Chrome trace-event format;  see trace.h
+ *
+ * This is linked into the rv_* programs too, so it mustn't use anything from the LSST stack
+ */
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "lsst/rasmussen/trace.h"
+
+namespace lsst {
+namespace rasmussen {
+
+bool Trace::_enabled = false;
+int Trace::_maxSpans = 1000000;
+
+namespace {
+    struct Record {
+        std::string name;
+        std::string category;
+        std::string args;
+        double t0, t1;
+    };
+    /*
+     * A thread's spans.  Only that thread adds to them, but write() may be reading at the same time,
+     * so they have their own (almost never contended) lock
+     */
+    struct ThreadLog {
+        int tid;
+        std::string name;
+        std::vector<Record> records;
+        int nDropped;
+        bool retired;                   // the thread's exited, so another may take over the log
+        pthread_mutex_t lock;
+    };
+
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER; // protects logs, and their retired flags
+    std::vector<ThreadLog *> logs;                    // every thread that's recorded anything
+    __thread ThreadLog *threadLog = NULL;
+
+    pthread_key_t key;                  // used to retire a thread's log when it exits
+    pthread_once_t keyOnce = PTHREAD_ONCE_INIT;
+
+    double origin = 0;                  // value of monotonicMicroseconds() at start();  atomic
+
+    double
+    monotonicMicroseconds()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return 1e6*ts.tv_sec + 1e-3*ts.tv_nsec;
+    }
+
+    /*
+     * Called as a thread exits:  its spans are kept until they're cleared, but the next new thread
+     * appends its own to them, so a program that keeps starting threads (e.g. a FitsReader per file)
+     * has as many logs as it ever had threads running at once, not one per thread it ever started.
+     * The threads' lifetimes don't overlap, so they can share a row in the timeline
+     */
+    void
+    retireThreadLog(void *threadLogPtr)
+    {
+        ThreadLog *log = static_cast<ThreadLog *>(threadLogPtr);
+
+        pthread_mutex_lock(&lock);
+        log->retired = true;
+        pthread_mutex_unlock(&lock);
+
+        threadLog = NULL;               // in case a later destructor records a span
+    }
+
+    void
+    makeKey()
+    {
+        pthread_key_create(&key, retireThreadLog);
+    }
+
+    ThreadLog *
+    getThreadLog()
+    {
+        if (threadLog == NULL) {
+            pthread_once(&keyOnce, makeKey);
+
+            ThreadLog *log = NULL;
+            pthread_mutex_lock(&lock);
+            for (std::vector<ThreadLog *>::iterator ptr = logs.begin(); ptr != logs.end(); ++ptr) {
+                if ((*ptr)->retired) {
+                    log = *ptr;
+                    log->retired = false;
+                    break;
+                }
+            }
+            if (log == NULL) {
+                log = new ThreadLog;
+                log->tid = logs.size() + 1;
+                log->nDropped = 0;
+                log->retired = false;
+                pthread_mutex_init(&log->lock, NULL);
+                logs.push_back(log);
+            }
+            pthread_mutex_unlock(&lock);
+
+            pthread_setspecific(key, log);
+            threadLog = log;
+        }
+        return threadLog;
+    }
+
+    std::string
+    escape(std::string const& str)
+    {
+        std::string escaped;
+        escaped.reserve(str.size());
+        for (std::string::const_iterator ptr = str.begin(); ptr != str.end(); ++ptr) {
+            if (*ptr == '"' || *ptr == '\\') {
+                escaped += '\\';
+                escaped += *ptr;
+            } else if (static_cast<unsigned char>(*ptr) < ' ') {
+                char buff[8];
+                sprintf(buff, "\\u%04x", static_cast<unsigned char>(*ptr));
+                escaped += buff;
+            } else {
+                escaped += *ptr;
+            }
+        }
+        return escaped;
+    }
+}
+
+void
+Trace::start()
+{
+    clear();
+    double const t0 = monotonicMicroseconds();
+    __atomic_store(&origin, &t0, __ATOMIC_RELAXED);
+    __atomic_store_n(&_enabled, true, __ATOMIC_RELEASE); // so a thread that sees _enabled sees origin
+}
+
+void
+Trace::stop()
+{
+    __atomic_store_n(&_enabled, false, __ATOMIC_RELEASE);
+}
+
+void
+Trace::clear()
+{
+    pthread_mutex_lock(&lock);
+    for (std::vector<ThreadLog *>::iterator ptr = logs.begin(); ptr != logs.end(); ++ptr) {
+        pthread_mutex_lock(&(*ptr)->lock);
+        (*ptr)->records.clear();
+        (*ptr)->nDropped = 0;
+        pthread_mutex_unlock(&(*ptr)->lock);
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+double
+Trace::now()
+{
+    double t0;
+    __atomic_load(&origin, &t0, __ATOMIC_RELAXED);
+    return monotonicMicroseconds() - t0;
+}
+
+void
+Trace::addSpan(std::string const& name, std::string const& category, double t0, double t1,
+               std::string const& args)
+{
+    if (!isEnabled()) {
+        return;
+    }
+    ThreadLog *log = getThreadLog();
+
+    pthread_mutex_lock(&log->lock);
+    if (static_cast<int>(log->records.size()) >= getMaxSpans()) {
+        ++log->nDropped;
+    } else {
+        log->records.push_back(Record());
+        Record & rec = log->records.back();
+        rec.name = name;
+        rec.category = category;
+        rec.args = args;
+        rec.t0 = t0;
+        rec.t1 = t1;
+    }
+    pthread_mutex_unlock(&log->lock);
+}
+
+void
+Trace::setThreadName(std::string const& name)
+{
+    ThreadLog *log = getThreadLog();
+
+    pthread_mutex_lock(&log->lock);
+    log->name = name;
+    pthread_mutex_unlock(&log->lock);
+}
+
+int
+Trace::getNSpans()
+{
+    int n = 0;
+    pthread_mutex_lock(&lock);
+    for (std::vector<ThreadLog *>::const_iterator ptr = logs.begin(); ptr != logs.end(); ++ptr) {
+        pthread_mutex_lock(&(*ptr)->lock);
+        n += (*ptr)->records.size();
+        pthread_mutex_unlock(&(*ptr)->lock);
+    }
+    pthread_mutex_unlock(&lock);
+
+    return n;
+}
+
+int
+Trace::getNDropped()
+{
+    int n = 0;
+    pthread_mutex_lock(&lock);
+    for (std::vector<ThreadLog *>::const_iterator ptr = logs.begin(); ptr != logs.end(); ++ptr) {
+        pthread_mutex_lock(&(*ptr)->lock);
+        n += (*ptr)->nDropped;
+        pthread_mutex_unlock(&(*ptr)->lock);
+    }
+    pthread_mutex_unlock(&lock);
+
+    return n;
+}
+
+void
+Trace::write(std::string const& fileName)
+{
+    FILE *fd = fopen(fileName.c_str(), "w");
+    if (fd == NULL) {
+        throw std::runtime_error("Unable to open " + fileName + " to write a trace");
+    }
+    int const pid = getpid();
+
+    fprintf(fd, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    char const *sep = "\n";            // separates the trace events
+    pthread_mutex_lock(&lock);
+    for (std::vector<ThreadLog *>::const_iterator ptr = logs.begin(); ptr != logs.end(); ++ptr) {
+        ThreadLog const *log = *ptr;
+        pthread_mutex_lock(&(*ptr)->lock);
+        if (!log->name.empty()) {
+            fprintf(fd, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %d, "
+                    "\"args\": {\"name\": \"%s\"}}", sep, pid, log->tid, escape(log->name).c_str());
+            sep = ",\n";
+        }
+        for (std::vector<Record>::const_iterator rec = log->records.begin(); rec != log->records.end(); ++rec) {
+            fprintf(fd, "%s{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, "
+                    "\"pid\": %d, \"tid\": %d", sep,
+                    escape(rec->name).c_str(), escape(rec->category).c_str(), rec->t0, rec->t1 - rec->t0,
+                    pid, log->tid);
+            if (!rec->args.empty()) {
+                fprintf(fd, ", \"args\": %s", rec->args.c_str());
+            }
+            fprintf(fd, "}");
+            sep = ",\n";
+        }
+        pthread_mutex_unlock(&(*ptr)->lock);
+    }
+    pthread_mutex_unlock(&lock);
+    fprintf(fd, "\n]}\n");
+
+    if (fclose(fd) != 0) {
+        throw std::runtime_error("Error writing trace to " + fileName);
+    }
+}
+
+void
+Trace::Span::addArg(char const *key, std::string const& value)
+{
+    if (_t0 >= 0) {
+        _args += (_args.empty() ? "\"" : ", \"") + escape(key) + "\": \"" + escape(value) + "\"";
+    }
+}
+
+void
+Trace::Span::addArg(char const *key, int value)
+{
+    if (_t0 >= 0) {
+        char buff[32];
+        sprintf(buff, "%d", value);
+        _args += (_args.empty() ? "\"" : ", \"") + escape(key) + "\": " + buff;
+    }
+}
+
+}}
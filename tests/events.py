@@ -36,10 +36,12 @@ import os
 import os.path
 
 import sys
+import threading
 import unittest
 
 import lsst.utils.tests as utilsTests
 import lsst.pex.exceptions
+import lsst.afw.detection as afwDetect
 import lsst.afw.image as afwImage
 import lsst.afw.geom as afwGeom
 import lsst.afw.display.ds9 as ds9
@@ -93,6 +95,564 @@ class EventsTestCase(unittest.TestCase):
             ras.Event(self.image, self.image.getBBox().getMax() + afwGeom.ExtentI(10, 10))
         utilsTests.assertRaisesLsstCpp(self, lsst.pex.exceptions.OutOfRangeException, offChip)
 
+    def testIntegerCtor(self):
+        """Check that we can extract events from raw integer ADUs, subtracting the bias as we go"""
+        bias = 1000
+        image = afwImage.ImageU(self.image.getDimensions(), bias)
+        image.set(self.xy0[0] - 1, self.xy0[1] - 1, bias + self.val0_0)
+        image.set(self.xy0[0], self.xy0[1], bias + self.val4_0)
+
+        ev = ras.Event(image, self.centers[0], -1, -1, bias)
+        for i in range(9):
+            self.assertEqual(ev[i], self.events[0][i])
+
+        tables = []
+        for pixelType in (ras.HistogramTable.SHORT, ras.HistogramTable.INT):
+            table = ras.HistogramTable(0, 20)
+            table.setPixelType(pixelType)
+            table.setCalctype(ras.HistogramTable.P_9)
+            self.assertTrue(table.process_event(ev))
+            tables.append((ev.grade, ev.sum, ev.p9))
+        self.assertEqual(tables[0], tables[1])
+
+    def testOverflow(self):
+        """Check that pixels too large for a short are flagged, and that we can saturate events"""
+        self.image.set(self.xy0[0], self.xy0[1], 40000)
+        ev = ras.Event(self.image, self.centers[0])
+
+        table = ras.HistogramTable(0, 20)
+        self.assertFalse(table.process_event(ev))
+        self.assertEqual(ev.flags, ras.Event.OVERFLOWED)
+        self.assertEqual(table.nsatur, 1)
+
+        for pixelType in (ras.HistogramTable.INT, ras.HistogramTable.FLOAT):
+            table.setPixelType(pixelType)
+            table.classify(ev)
+            self.assertEqual(ev.flags, 0)
+            self.assertEqual(ev.sum, 40000)
+
+        table.setSaturation(30000)
+        table.classify(ev)
+        self.assertEqual(ev.flags, ras.Event.SATURATED)
+
+    def testNaN(self):
+        """Check that NaN pixels are flagged, and classified as 0"""
+        self.image.set(self.xy0[0] - 1, self.xy0[1] - 1, float("NaN"))
+        ev = ras.Event(self.image, self.centers[0])
+
+        table = ras.HistogramTable(0, 20)
+        for pixelType in (ras.HistogramTable.SHORT, ras.HistogramTable.INT, ras.HistogramTable.FLOAT):
+            table.setPixelType(pixelType)
+            table.classify(ev)
+            self.assertEqual(ev.flags, ras.Event.OVERFLOWED)
+            self.assertEqual(ev.sum, self.val4_0)
+
+        self.assertFalse(table.process_event(ev))
+
+    def testExtractEvents(self):
+        """Check that extracting a list of peaks matches the Event constructor, and the edge policies"""
+        width, height = self.image.getDimensions()
+        x = numpy.array([self.xy0[0], 50, 0, width - 1, width + 10], dtype=numpy.int32)
+        y = numpy.array([self.xy0[1], 100, 100, height - 1, 10], dtype=numpy.int32)
+        self.image.set(0, 100, 10)
+        self.image.set(width - 1, height - 1, 20)
+
+        extractor = ras.EventExtractor()
+        events = extractor.extractEvents(self.image, x, y, 1, 2)
+        self.assertEqual(len(events), 2)
+        self.assertEqual(extractor.getNEdge(), 2)
+        self.assertEqual(extractor.getNSkipped(), 3)
+        for ev, ev0 in zip(events, self.events):
+            self.assertEqual((ev.x, ev.y, ev.framenum, ev.chipnum), (ev0.x, ev0.y, 1, 2))
+            self.assertEqual([ev[i] for i in range(9)], [ev0[i] for i in range(9)])
+
+        for policy, ev2 in [(ras.EventExtractor.CLAMP, [0, 0, 0, 10, 10, 0, 0, 0, 0]),
+                            (ras.EventExtractor.ZERO_PAD, [0, 0, 0, 0, 10, 0, 0, 0, 0]),
+                            (ras.EventExtractor.FLAG, [0, 0, 0, 0, 10, 0, 0, 0, 0])]:
+            extractor.setEdgePolicy(policy)
+            events = extractor.extractEvents(self.image, x, y)
+            self.assertEqual(len(events), 4)
+            self.assertEqual(extractor.getNSkipped(), 1) # (width + 10, 10) isn't in the image
+            self.assertEqual([events[2][i] for i in range(9)], ev2)
+            self.assertEqual(events[3][4], 20)
+            self.assertEqual(events[2].flags, ras.Event.EDGE if policy == ras.EventExtractor.FLAG else 0)
+
+        table = ras.HistogramTable(0, 5)
+        self.assertFalse(table.process_event(events[2])) # FLAGged events aren't histogrammed
+        self.assertEqual(events[2].flags, ras.Event.EDGE)
+        #
+        # Nor are they selected by EventFilter, or histogrammed by HistogramBank, whether or not they
+        # went through EventColumns.  Events 2 and 3 are FLAGged, and would otherwise be used
+        #
+        def useEvents(events):
+            columns = ras.EventColumns()
+            columns.append(events)
+            bank = ras.HistogramBank([0], [5], [ras.HistogramTable.P_9])
+            bank.process(events)
+            bank.process(columns)
+            return list(columns.getFlags()), list(ras.EventFilter().apply(columns, table)), \
+                bank.getTable(0).nsngle()
+
+        flags, selected, nSingle = useEvents(events)
+        self.assertEqual(flags, [0, 0, ras.Event.EDGE, ras.Event.EDGE])
+        for ev in events:
+            ev.flags = 0
+        flags0, selected0, nSingle0 = useEvents(events)
+        self.assertEqual(flags0, [0, 0, 0, 0])
+        self.assertTrue(2 in selected0 and 3 in selected0)
+        self.assertEqual(selected, [i for i in selected0 if i not in (2, 3)])
+        self.assertEqual(nSingle, nSingle0 - 2*2) # the bank saw events 2 and 3 twice each
+
+    def testPeakFinder(self):
+        """Check that PeakFinder finds the same peaks as FootprintSet"""
+        self.image.set(60, 150, 80)
+        self.image.set(61, 151, 70)     # joins (60, 150) and (62, 150) into one blob, but isn't a peak
+        self.image.set(62, 150, 90)
+
+        finder = ras.PeakFinder(50, True)
+        self.assertEqual(finder.findPeaks(self.image), 3)
+        peaks = zip(finder.getX(), finder.getY(), finder.getValues())
+        self.assertEqual(peaks, [(self.xy0[0], self.xy0[1], self.val4_0), (60, 150, 80), (62, 150, 90)])
+
+        fs = afwDetect.FootprintSet(self.image, afwDetect.Threshold(50))
+        self.assertEqual(sorted((p.getIx(), p.getIy()) for foot in fs.getFootprints() for p in foot.getPeaks()),
+                         sorted(p[:2] for p in peaks))
+
+        sub = self.image.Factory(self.image, afwGeom.BoxI(afwGeom.PointI(5, 20), afwGeom.ExtentI(20, 20)))
+        self.assertEqual(finder.findPeaks(sub), 1)
+        self.assertEqual((finder.getX()[0], finder.getY()[0]), self.xy0) # in the parent's coordinates
+
+        self.image.set(63, 150, 90)     # a flat-topped peak is only found once
+        finder.setFindValues(False)
+        self.assertEqual(finder.findPeaks(self.image), 3)
+        self.assertEqual(len(finder.getValues()), 0)
+
+    def testCountGrades(self):
+        """Check that counting a column of grades matches counting them one by one"""
+        grades = numpy.array([0, 1, 7, 7, 3, -1, 6, 7, 2, 8, 5, 4, 0], dtype=numpy.int32)
+
+        table = ras.HistogramTable()
+        table.countGrades(grades)
+
+        self.assertEqual(table.ntotal, 11)
+        self.assertEqual([table.nsngle(), table.nsplus(), table.npvert(), table.npleft(),
+                          table.nprght(), table.npplus(), table.nelnsq(), table.nother()],
+                         [2, 1, 1, 1, 1, 1, 1, 3])
+
+    def testFilter(self):
+        """Check that EventFilter applies its raw and post-classification cuts"""
+        columns = ras.EventColumns()
+        columns.append(self.events)
+        self.assertEqual(columns.size(), 2)
+        self.assertEqual(list(columns.getX()), [ev.x for ev in self.events])
+
+        table = ras.HistogramTable(1, 20)   # the second event is all zeros, so fails the event threshold
+        filt = ras.EventFilter()
+        self.assertEqual(list(filt.apply(columns, table)), [0])
+        self.assertEqual(columns.getGrade()[0], ras.Event.SINGLE_P_CORNER)
+
+        filt.setGrades(1 << ras.Event.SINGLE)
+        self.assertEqual(list(filt.apply(columns, table)), [])
+        filt.setGrades(1 << ras.Event.SINGLE_P_CORNER)
+        self.assertEqual(list(filt.apply(columns, table)), [0])
+
+        filt.setPhaRange(0, self.val4_0)
+        self.assertEqual(list(filt.apply(columns, table)), [])
+        filt.setPhaRange(self.val4_0, self.val4_0 + 1)
+        self.assertEqual(list(filt.apply(columns, table)), [0])
+
+        filt.setXRange(self.xy0[0] + 1, 100)
+        self.assertEqual(list(filt.apply(columns, table)), [])
+
+    def testNumpyViews(self):
+        """Check that the numpy views of an Event and of EventColumns share the events' memory"""
+        ev = self.events[0]
+        data = ev.getArray()
+        self.assertEqual(list(data), [ev[i] for i in range(9)])
+        data[4] += 1
+        self.assertEqual(ev[4], self.val4_0 + 1)
+
+        columns = ras.EventColumns()
+        columns.append(self.events)
+        self.assertEqual(len(columns), 2)
+        self.assertEqual(columns.getData().shape, (2, 9))
+        self.assertEqual(list(columns.getData()[0]), list(data))
+        self.assertEqual(list(columns.getY()), [e.y for e in self.events])
+
+        x = columns.getX()
+        x[1] = 42
+        self.assertEqual(columns.getEvent(1).x, 42)
+
+    def testThreads(self):
+        """Check that filtering events from several threads, sharing a HistogramTable, is the same as serially"""
+        table = ras.HistogramTable(1, 20)
+        filt = ras.EventFilter()
+
+        columns = []
+        for i in range(4):
+            columns.append(ras.EventColumns())
+            columns[-1].append(self.events)
+        results = len(columns)*[None]
+
+        def work(i):
+            results[i] = list(filt.apply(columns[i], table))
+        threads = [threading.Thread(target=work, args=(i,)) for i in range(len(columns))]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+
+        self.assertEqual(results, len(columns)*[[0]])
+        for c in columns:
+            self.assertEqual(c.getGrade()[0], ras.Event.SINGLE_P_CORNER)
+
+    def testInstrumentation(self):
+        """Check that we count extracted and classified events, and the reasons for rejecting them"""
+        Inst = ras.Instrumentation
+        if not Inst.isEnabled():
+            return
+
+        Inst.reset()
+        self.assertEqual(Inst.getEvents(Inst.EXTRACT), 0)
+
+        ev = ras.Event(self.image, self.centers[0])
+        try:
+            ras.Event(self.image, self.image.getBBox().getMax())
+        except lsst.pex.exceptions.LsstCppException:
+            pass
+        self.assertEqual(Inst.getEvents(Inst.EXTRACT), 1)
+        self.assertEqual(Inst.getRejected(Inst.EDGE), 1)
+
+        table = ras.HistogramTable(1, 20)   # the second event is all zeros, so fails the event threshold
+        table.setFilter(1 << ras.Event.SINGLE) # ev is SINGLE_P_CORNER
+        self.assertFalse(table.process_event(ev))
+        self.assertFalse(table.process_event(ev)) # the classification's cached, so isn't counted again
+        self.assertFalse(table.process_event(self.events[1]))
+        self.assertEqual(Inst.getEvents(Inst.CLASSIFY), 1)
+        self.assertEqual(Inst.getEvents(Inst.HISTOGRAM), 3)
+        self.assertEqual(Inst.getRejected(Inst.GRADE_FILTER), 2)
+        self.assertEqual(Inst.getRejected(Inst.BELOW_THRESHOLD), 1)
+
+        Inst.addSeconds(Inst.DETECT, 2.0, 10)
+        self.assertAlmostEqual(Inst.getSeconds(Inst.DETECT), 2.0, 3)
+        self.assertAlmostEqual(Inst.getEventRate(Inst.DETECT), 5.0, 3)
+
+        import json
+        stats = json.loads(Inst.toJson())
+        self.assertEqual(stats["stages"][Inst.getStageName(Inst.HISTOGRAM)]["events"], 3)
+        self.assertEqual(stats["rejected"][Inst.getReasonName(Inst.EDGE)], 1)
+
+        Inst.reset()
+        self.assertEqual(Inst.getRejected(Inst.EDGE), 0)
+
+    def testTrace(self):
+        """Check that we can record spans from python and C++, and write them as a trace-event file"""
+        import json, tempfile
+        import lsst.rasmussen.trace as trace
+
+        fd, fileName = tempfile.mkstemp(suffix=".fits")
+        os.close(fd)
+        traceFile = fileName + ".json"
+        try:
+            self.image.writeFits(fileName)
+
+            trace.start()
+            with trace.span("read", "file", file=fileName):
+                reader = ras.FitsReader(fileName, ras.FitsReader.FLOAT, 2)
+                while reader.next():
+                    pass
+            del reader
+            trace.write(traceFile)
+
+            spans = [ev for ev in json.load(open(traceFile))["traceEvents"] if ev["ph"] == "X"]
+            self.assertEqual(len(spans), ras.Trace.getNSpans())
+            self.assertEqual([ev["args"]["file"] for ev in spans if ev["name"] == "read"], [fileName])
+            self.assertEqual([ev["args"]["hdu"] for ev in spans if ev["cat"] == "hdu"], [1])
+        finally:
+            for name in (fileName, traceFile):
+                if os.path.exists(name):
+                    os.remove(name)
+
+        ras.Trace.clear()
+        with trace.span("ignored", "file"): # we've stopped recording
+            pass
+        self.assertEqual(ras.Trace.getNSpans(), 0)
+
+    def testAccumulate(self):
+        """Check that accumulating a classified event is the same as processing it"""
+        processed = ras.HistogramTable(0, 20)
+        self.assertTrue(processed.process_event(self.events[0]))
+
+        accumulated = ras.HistogramTable(0, 20)
+        accumulated.classify(self.events[0])
+        self.assertTrue(accumulated.accumulate(self.events[0]))
+
+        self.assertEqual(accumulated.ntotal, processed.ntotal)
+        self.assertEqual(accumulated.nsplus(), processed.nsplus())
+
+    def testMerge(self):
+        """Check that merging tables that saw some of the events is the same as seeing all of them"""
+        serial = ras.HistogramTable(0, 20)
+        for ev in self.events:
+            serial.process_event(ras.Event(ev))
+
+        merged = ras.HistogramTable(0, 20)
+        for ev in self.events:
+            shard = ras.HistogramTable(0, 20)
+            shard.process_event(ras.Event(ev))
+
+            copy = ras.HistogramTable(0, 20) # as if it came from another process
+            copy.setState(shard.getState())
+            merged.merge(copy)
+
+        state, mergedState = serial.getState(), merged.getState()
+        self.assertTrue((state.pop("histo") == mergedState.pop("histo")).all())
+        self.assertEqual(state, mergedState)
+        self.assertEqual(merged.ntotal, len(self.events))
+
+        self.assertRaises(Exception, merged.merge, ras.HistogramTable(1, 20))
+
+    def testClassificationCache(self):
+        """Check that an Event's classification is reused only by tables with the same ClassificationKey"""
+        ev = self.events[0]
+        self.assertFalse(ev.classifiedBy.isValid())
+
+        table = ras.HistogramTable(0, 20)
+        table.process_event(ev)
+        self.assertTrue(ev.classifiedBy == table.getClassificationKey())
+        grade = ev.grade
+
+        table2 = ras.HistogramTable(0, 20, ras.HistogramTable.TNONE, 0.0, 1 << ras.Event.SINGLE)
+        self.assertTrue(table2.getClassificationKey() == table.getClassificationKey())
+
+        ev.sum = -1                     # poison the cache, so we can tell whether it was used
+        table2.classify(ev)
+        self.assertEqual(ev.sum, -1)
+
+        table2.setCalctype(ras.HistogramTable.P_9)
+        table2.classify(ev)
+        self.assertEqual(ev.sum, self.val4_0)
+        self.assertEqual(ev.grade, grade)
+
+    def testHistogramBank(self):
+        """Check that a HistogramBank's tables match tables filled one at a time"""
+        thresholds, splits, calcTypes = [0, 200, 1000], [20, 150], [ras.HistogramTable.P_9]
+        bank = ras.HistogramBank(thresholds, splits, calcTypes)
+        self.assertEqual(bank.size(), 6)
+        bank.process(self.events)
+
+        for i in range(bank.size()):
+            table = ras.HistogramTable(bank.getEventThreshold(i), bank.getSplitThreshold(i),
+                                       ras.HistogramTable.TNONE, 0.0, ~0, bank.getCalctype(i))
+            for ev in self.events:
+                table.process_event(ras.Event(ev))
+
+            btable = bank.getTable(i)
+            self.assertEqual(btable.ntotal, table.ntotal)
+            self.assertEqual(btable.nbevth, table.nbevth)
+            self.assertEqual(btable.nsngle(), table.nsngle())
+            self.assertEqual(btable.nsplus(), table.nsplus())
+
+        self.assertEqual(bank.getTable(200, 150, ras.HistogramTable.P_9).nsngle(), 1)
+
+    def testEventFile(self):
+        """Check that events survive a trip through writeEventFile and readEventFile"""
+        import tempfile
+        fd, fileName = tempfile.mkstemp(suffix=".ev")
+        os.close(fd)
+        try:
+            ras.writeEventFile(fileName, self.events)
+            self.assertEqual(os.path.getsize(fileName), 56*len(self.events)) # sizeof(data_str)
+
+            events = ras.readEventFile(fileName)
+            self.assertEqual(len(events), len(self.events))
+            for ev, ev0 in zip(events, self.events):
+                self.assertEqual((ev.x, ev.y, ev.framenum, ev.chipnum), (ev0.x, ev0.y, ev0.framenum, ev0.chipnum))
+                for i in range(9):
+                    self.assertEqual(ev[i], ev0[i])
+        finally:
+            os.remove(fileName)
+
+    def testEventCache(self):
+        """Check that EventCache hits and misses when it should"""
+        import shutil, tempfile
+        import lsst.rasmussen.eventCache as eventCache
+
+        tmpDir = tempfile.mkdtemp()
+        try:
+            fileName = os.path.join(tmpDir, "image.fits")
+            with open(fileName, "w") as fd:
+                fd.write("Some pixels")
+
+            cache = eventCache.EventCache(os.path.join(tmpDir, "cache"))
+            key = cache.getKey(fileName, 20, "median", False)
+            self.assertEqual(cache.load(fileName, key), None)
+
+            cache.save(fileName, key, self.events, set([1, 3]))
+            events, ampIds = cache.load(fileName, key)
+            self.assertEqual([(ev.x, ev.y) for ev in events], [(ev.x, ev.y) for ev in self.events])
+            self.assertEqual(ampIds, set([1, 3]))
+            #
+            # A new EventCache (e.g. the next run) reads the same index
+            #
+            cache = eventCache.EventCache(os.path.join(tmpDir, "cache"))
+            self.assertEqual(cache.getKey(fileName, 20, "median", False), key)
+            self.assertNotEqual(cache.load(fileName, key), None)
+            #
+            # Changing any of the search settings misses
+            #
+            for args in [(21, "median", False), (20, "medianInt", False), (20, "median", True),
+                         (20, "median", False, True)]:
+                newKey = cache.getKey(fileName, *args)
+                self.assertNotEqual(newKey, key)
+                self.assertEqual(cache.load(fileName, newKey), None)
+            #
+            # Touching the file doesn't change its key, but changing its contents does
+            #
+            st = os.stat(fileName)
+            os.utime(fileName, (st.st_atime, st.st_mtime + 10))
+            self.assertEqual(cache.getKey(fileName, 20, "median", False), key)
+
+            with open(fileName, "w") as fd:
+                fd.write("Some other pixels")
+            os.utime(fileName, (st.st_atime, st.st_mtime + 20))
+            self.assertNotEqual(cache.getKey(fileName, 20, "median", False), key)
+        finally:
+            shutil.rmtree(tmpDir)
+
+    def testAmpGeometry(self):
+        """Check that the geometry read from a header matches the ab initio one, and is cached"""
+        import lsst.daf.base as dafBase
+
+        for channelNo, ltv, ltm in [(1, (0, 0), 1), (16, (542, 4044), -1)]:
+            md = dafBase.PropertyList()
+            md.set("CHANNEL", channelNo)
+            md.set("DATASEC", "[1:542,1:2022]")
+            md.set("LTV1", ltv[0])
+            md.set("LTV2", ltv[1])
+            md.set("LTM1_1", float(ltm))
+            md.set("LTM2_2", float(ltm))
+
+            geom, geom0 = ras.getAmpGeometry(md), ras.getAmpGeometry(channelNo)
+            for field in ("iCol", "iRow", "rotate90", "flipLR", "width", "height",
+                          "dataX0", "dataWidth", "biasX0", "biasWidth"):
+                self.assertEqual(getattr(geom, field), getattr(geom0, field))
+
+            self.assertEqual(int(ras.getAmpGeometry(md).this), int(geom.this))
+
+    def testFitsReader(self):
+        """Check that FitsReader reads plain and gzipped files, with and without threads"""
+        import gzip, shutil, tempfile
+        fd, fileName = tempfile.mkstemp(suffix=".fits")
+        os.close(fd)
+        try:
+            self.image.writeFits(fileName)
+            with open(fileName, "rb") as fin:
+                gz = gzip.open(fileName + ".gz", "wb")
+                shutil.copyfileobj(fin, gz)
+                gz.close()
+
+            for name in (fileName, fileName + ".gz"):
+                for nThread in (-1, 0, 2):
+                    reader = ras.FitsReader(name, ras.FitsReader.FLOAT, nThread)
+                    self.assertEqual(reader.size(), 1)
+                    hdu = reader.next()
+                    self.assertEqual(hdu.getHdu(), 1)
+                    self.assertTrue(numpy.all(hdu.getImageF().getArray() == self.image.getArray()))
+                    self.assertEqual(reader.next(), None)
+        finally:
+            for name in (fileName, fileName + ".gz"):
+                if os.path.exists(name):
+                    os.remove(name)
+
+    def testAssembleCcd(self):
+        """Check that assembleCcd bias subtracts, trims, flips and gain corrects each amp"""
+        import tempfile
+        #
+        # Two 6x4 amps, with the data in the left 4 columns and the overclock in the right 2;
+        # the second amp is flipped left-right into the CCD, to the right of the first
+        #
+        def makeAmp(channel, flipLR):
+            amp = ras.AmpGeometry()
+            amp.channel = channel       # i.e. in HDU 1 + channel
+            amp.iCol, amp.iRow, amp.rotate90, amp.flipLR = channel, 0, 0, flipLR
+            amp.width, amp.height = 6, 4
+            amp.dataX0, amp.dataY0, amp.dataWidth, amp.dataHeight = 0, 0, 4, 4
+            amp.biasX0, amp.biasY0, amp.biasWidth, amp.biasHeight = 4, 0, 2, 4
+            return amp
+
+        amps = ras.vectorAmpGeometry()
+        amps.push_back(makeAmp(0, False))
+        amps.push_back(makeAmp(1, True))
+        gains = numpy.array([1.0, 2.0], dtype=numpy.float64)
+
+        fd, fileName = tempfile.mkstemp(suffix=".fits")
+        os.close(fd)
+        try:
+            for channel in (0, 1):
+                im = afwImage.ImageF(afwGeom.ExtentI(6, 4))
+                for y in range(4):
+                    for x in range(4):
+                        im.set(x, y, 1000*(channel + 1) + 10*y + x)
+                    im.set(4, y, 20*(channel + 1) + (channel + 1)*y) # the row's median bias is the mean
+                    im.set(5, y, 30*(channel + 1) + (channel + 1)*y) # of these two
+                im.writeFits(fileName, None, "w" if channel == 0 else "a")
+
+            expected = numpy.empty((4, 8), dtype=numpy.float32)
+            for y in range(4):
+                for x in range(4):
+                    expected[y, x] = (1000 + 10*y + x) - (25 + y)
+                    expected[y, 7 - x] = ((2000 + 10*y + x) - (50 + 2*y))/2.0
+
+            for nThread in (1, 0):
+                ccdImage = ras.assembleCcd(fileName, amps, gains, True, True, nThread)
+                self.assertEqual(ccdImage.getDimensions(), afwGeom.ExtentI(8, 4))
+                self.assertTrue(numpy.all(ccdImage.getArray() == expected))
+            #
+            # An amp whose HDU isn't there
+            #
+            amps.push_back(makeAmp(2, False))
+            utilsTests.assertRaisesLsstCpp(self, lsst.pex.exceptions.IoErrorException,
+                                           lambda: ras.assembleCcd(fileName, amps,
+                                                                   numpy.ones(3, dtype=numpy.float64)))
+        finally:
+            os.remove(fileName)
+
+    def testMeasurementAlgorithm(self):
+        """Check that the fe55 measurement algorithm classifies sources just as HistogramTable does"""
+        import lsst.afw.table as afwTable
+        import lsst.meas.algorithms as measAlg
+
+        config = measAlg.SourceMeasurementConfig()
+        config.algorithms.names = ["fe55"]
+        config.algorithms["fe55"].split = 10
+        config.centroider.name = None
+        for slot in ("centroid", "shape", "apFlux", "modelFlux", "psfFlux", "instFlux"):
+            setattr(config.slots, slot, None)
+
+        schema = afwTable.SourceTable.makeMinimalSchema()
+        ms = config.makeMeasureSources(schema)
+        table = afwTable.SourceTable.make(schema)
+        exposure = afwImage.makeExposure(afwImage.makeMaskedImage(self.image))
+
+        htable = ras.HistogramTable(0, 10)
+        for cen, ev in zip(self.centers, self.events):
+            source = table.makeRecord()
+            ms.apply(source, exposure, afwGeom.Point2D(cen))
+            htable.classify(ev)
+
+            self.assertEqual(source.get("fe55.grade"), ev.grade)
+            self.assertEqual(source.get("fe55.sum"), ev.sum)
+            self.assertEqual(source.get("fe55.p9"), ev.p9)
+            self.assertFalse(source.get("fe55.flags"))
+        #
+        # A source too close to the edge to have a 3x3 stamp
+        #
+        source = table.makeRecord()
+        ms.apply(source, exposure, afwGeom.Point2D(0, 0))
+        self.assertEqual(source.get("fe55.grade"), ras.Event.UNKNOWN)
+        self.assertTrue(source.get("fe55.flags"))
+
     def testProcessOneEvent(self):
         self.table.process_event(self.events[0])
         self.table.dump_hist()